@@ -0,0 +1,382 @@
+/*
+ * maomao-bench: 在wlroots headless后端+pixman渲染器上启动一个真正的maomao,
+ * 用maomao-bench-client开N个窗口,再通过socket ipc执行一组固定的操作
+ * (切换标签,轮换布局,开关overview,scroller里连续切换焦点),
+ * 统计每一步引起的configure次数,输出的帧数,以及从发出命令到最后一个窗口
+ * ack并提交的时间.
+ *
+ *   maomao-bench [-n 窗口数] [-q 静默毫秒] [-m maomao路径] [-c 客户端路径]
+ */
+#define _XOPEN_SOURCE 700
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifndef MAOMAO_BIN
+#define MAOMAO_BIN "maomao"
+#endif
+#ifndef BENCH_CLIENT_BIN
+#define BENCH_CLIENT_BIN "maomao-bench-client"
+#endif
+
+typedef struct {
+	const char *name;
+	unsigned int steps;
+	unsigned long long configures, frames;
+	uint64_t latency_sum, latency_max;
+} Result;
+
+static char runtime_dir[] = "/tmp/maomao-bench-XXXXXX";
+static pid_t compositor_pid = -1, client_pid = -1;
+static int ipc_fd = -1, client_fd = -1;
+static char ipc_in[1 << 16];
+static size_t ipc_in_len;
+static char client_in[4096];
+static size_t client_in_len;
+static int quiet_ms = 200;
+
+static void cleanup(void);
+
+static void die(const char *msg) {
+	fprintf(stderr, "maomao-bench: %s", msg);
+	if (errno)
+		fprintf(stderr, ": %s", strerror(errno));
+	fputc('\n', stderr);
+	cleanup();
+	exit(1);
+}
+
+static uint64_t monotonic_ns(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+static int remove_entry(const char *path, const struct stat *sb, int flag,
+						struct FTW *ftw) {
+	remove(path);
+	return 0;
+}
+
+static void cleanup(void) {
+	if (client_pid > 0) {
+		kill(client_pid, SIGTERM);
+		waitpid(client_pid, NULL, 0);
+		client_pid = -1;
+	}
+	if (compositor_pid > 0) {
+		kill(compositor_pid, SIGTERM);
+		waitpid(compositor_pid, NULL, 0);
+		compositor_pid = -1;
+	}
+	nftw(runtime_dir, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+// stdout_fd为-1时输出到/dev/null,stderr_fd为-1时继承
+static pid_t spawn(char *const argv[], int stdout_fd, int stderr_fd) {
+	pid_t pid;
+	int null_fd;
+
+	if ((pid = fork()) < 0)
+		die("fork");
+	if (pid == 0) {
+		null_fd = open("/dev/null", O_RDWR);
+		dup2(null_fd, STDIN_FILENO);
+		dup2(stdout_fd >= 0 ? stdout_fd : null_fd, STDOUT_FILENO);
+		if (stderr_fd >= 0)
+			dup2(stderr_fd, STDERR_FILENO);
+		execvp(argv[0], argv);
+		fprintf(stderr, "maomao-bench: exec %s: %s\n", argv[0],
+				strerror(errno));
+		_exit(127);
+	}
+	return pid;
+}
+
+static void write_config(void) {
+	char path[256];
+	FILE *f;
+
+	snprintf(path, sizeof(path), "%s/.config", runtime_dir);
+	mkdir(path, 0700);
+	snprintf(path, sizeof(path), "%s/.config/maomao", runtime_dir);
+	mkdir(path, 0700);
+	snprintf(path, sizeof(path), "%s/.config/maomao/config.conf",
+			 runtime_dir);
+	if (!(f = fopen(path, "w")))
+		die("write config");
+	// 固定配置,不受本机配置影响
+	fprintf(f, "animations=1\n"
+			   "layer_animations=0\n"
+			   "blur=0\n"
+			   "shadows=0\n");
+	fclose(f);
+}
+
+static void start_compositor(const char *maomao) {
+	char log_path[256];
+	char *argv[] = {(char *)maomao, NULL};
+	int log_fd;
+
+	setenv("XDG_RUNTIME_DIR", runtime_dir, 1);
+	setenv("HOME", runtime_dir, 1);
+	setenv("WLR_BACKENDS", "headless", 1);
+	setenv("WLR_RENDERER", "pixman", 1);
+	setenv("WLR_HEADLESS_OUTPUTS", "1", 1);
+	setenv("WLR_LIBINPUT_NO_DEVICES", "1", 1);
+	unsetenv("WAYLAND_DISPLAY");
+	unsetenv("DISPLAY");
+
+	snprintf(log_path, sizeof(log_path), "%s/maomao.log", runtime_dir);
+	if ((log_fd = open(log_path, O_WRONLY | O_CREAT | O_TRUNC, 0600)) < 0)
+		die("open log");
+	compositor_pid = spawn(argv, log_fd, log_fd);
+	close(log_fd);
+}
+
+static void connect_ipc(void) {
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	struct timespec delay = {.tv_nsec = 50000000};
+	int i;
+
+	// 运行目录是新建的,第一个wayland socket一定是wayland-0
+	snprintf(addr.sun_path, sizeof(addr.sun_path),
+			 "%s/maomao-wayland-0.sock", runtime_dir);
+
+	for (i = 0; i < 200; i++) {
+		if ((ipc_fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+			die("socket");
+		if (connect(ipc_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0)
+			return;
+		close(ipc_fd);
+		ipc_fd = -1;
+		if (waitpid(compositor_pid, NULL, WNOHANG) == compositor_pid) {
+			compositor_pid = -1;
+			errno = 0;
+			die("compositor exited during startup, see maomao.log");
+		}
+		nanosleep(&delay, NULL);
+	}
+	errno = 0;
+	die("timed out waiting for the ipc socket");
+}
+
+// 从fd读一行,超时返回false
+static bool read_line(int fd, char *buf, size_t size, size_t *len, char *line,
+					  size_t line_size, int timeout_ms) {
+	struct pollfd pfd = {.fd = fd, .events = POLLIN};
+	char *nl;
+	size_t n;
+	ssize_t r;
+
+	for (;;) {
+		if ((nl = memchr(buf, '\n', *len))) {
+			n = nl - buf;
+			snprintf(line, line_size, "%.*s", (int)n, buf);
+			memmove(buf, nl + 1, *len - n - 1);
+			*len -= n + 1;
+			return true;
+		}
+		if (*len == size)
+			*len = 0; // 行太长,直接丢掉
+		if (poll(&pfd, 1, timeout_ms) <= 0)
+			return false;
+		if ((r = read(fd, buf + *len, size - *len)) <= 0) {
+			errno = 0;
+			die("connection closed");
+		}
+		*len += r;
+	}
+}
+
+/* 发一条ipc命令,等待回复.
+ * event不为NULL时保存回复之前的最后一个事件 */
+static bool ipc_request(const char *cmd, char *event, size_t event_size) {
+	static char line[1 << 16];
+	size_t len = strlen(cmd);
+
+	if (write(ipc_fd, cmd, len) != (ssize_t)len || write(ipc_fd, "\n", 1) != 1)
+		die("ipc write");
+
+	while (read_line(ipc_fd, ipc_in, sizeof(ipc_in), &ipc_in_len, line,
+					 sizeof(line), 10000)) {
+		if (strncmp(line, "{\"success\":", 11) == 0)
+			return strncmp(line + 11, "true", 4) == 0;
+		if (event)
+			snprintf(event, event_size, "%s", line);
+	}
+	errno = 0;
+	die("timed out waiting for ipc reply");
+	return false;
+}
+
+// 所有输出的帧数之和
+static unsigned long long output_frames(void) {
+	static char event[1 << 16];
+	unsigned long long frames = 0;
+	char *p = event;
+
+	event[0] = '\0';
+	if (!ipc_request("get frames", event, sizeof(event)))
+		return 0;
+	while ((p = strstr(p, "\"frames\":"))) {
+		p += strlen("\"frames\":");
+		frames += strtoull(p, &p, 10);
+	}
+	return frames;
+}
+
+/* 读客户端的输出直到静默quiet_ms毫秒,
+ * 返回configure次数,last为最后一次configure的时间 */
+static unsigned int drain_client(uint64_t *last) {
+	char line[256];
+	unsigned int count = 0;
+
+	while (read_line(client_fd, client_in, sizeof(client_in), &client_in_len,
+					 line, sizeof(line), quiet_ms)) {
+		if (strncmp(line, "configure ", 10) == 0) {
+			count++;
+			if (last)
+				*last = strtoull(line + 10, NULL, 10);
+		}
+	}
+	return count;
+}
+
+static void start_clients(const char *client, int nwindows) {
+	char count[16], line[256];
+	char *argv[] = {(char *)client, count, NULL};
+	int fds[2];
+
+	snprintf(count, sizeof(count), "%d", nwindows);
+	setenv("WAYLAND_DISPLAY", "wayland-0", 1);
+	if (pipe(fds) < 0)
+		die("pipe");
+	client_pid = spawn(argv, fds[1], -1);
+	close(fds[1]);
+	client_fd = fds[0];
+
+	for (;;) {
+		if (!read_line(client_fd, client_in, sizeof(client_in),
+					   &client_in_len, line, sizeof(line), 30000)) {
+			errno = 0;
+			die("timed out waiting for clients to map");
+		}
+		if (strcmp(line, "ready") == 0)
+			break;
+	}
+	drain_client(NULL);
+}
+
+static void run_step(Result *r, const char *cmd) {
+	char line[256];
+	unsigned long long frames = output_frames();
+	uint64_t start, last = 0, latency;
+	unsigned int configures;
+
+	snprintf(line, sizeof(line), "dispatch %s", cmd);
+	start = monotonic_ns();
+	if (!ipc_request(line, NULL, 0)) {
+		errno = 0;
+		fprintf(stderr, "maomao-bench: dispatch failed: %s\n", cmd);
+	}
+	configures = drain_client(&last);
+	latency = last > start ? last - start : 0;
+
+	r->steps++;
+	r->configures += configures;
+	r->frames += output_frames() - frames;
+	r->latency_sum += latency;
+	if (latency > r->latency_max)
+		r->latency_max = latency;
+}
+
+static void print_result(Result *r) {
+	printf("%-12s %6u %12llu %10llu %12.3f %12.3f\n", r->name, r->steps,
+		   r->configures, r->frames,
+		   r->steps ? r->latency_sum / 1e6 / r->steps : 0,
+		   r->latency_max / 1e6);
+}
+
+int main(int argc, char *argv[]) {
+	const char *maomao = MAOMAO_BIN, *client = BENCH_CLIENT_BIN;
+	Result tags = {.name = "tags"}, layouts = {.name = "layouts"},
+		   overview = {.name = "overview"}, scroller = {.name = "scroller"};
+	char cmd[64];
+	int nwindows = 200, opt, i;
+
+	while ((opt = getopt(argc, argv, "n:q:m:c:")) != -1) {
+		switch (opt) {
+		case 'n':
+			nwindows = atoi(optarg);
+			break;
+		case 'q':
+			quiet_ms = atoi(optarg);
+			break;
+		case 'm':
+			maomao = optarg;
+			break;
+		case 'c':
+			client = optarg;
+			break;
+		default:
+			fprintf(stderr,
+					"Usage: %s [-n windows] [-q quiet_ms] [-m maomao] "
+					"[-c client]\n",
+					argv[0]);
+			return 1;
+		}
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	if (!mkdtemp(runtime_dir))
+		die("mkdtemp");
+	write_config();
+	start_compositor(maomao);
+	connect_ipc();
+	start_clients(client, nwindows);
+
+	for (i = 2; i <= 9; i++) {
+		snprintf(cmd, sizeof(cmd), "view %d", i);
+		run_step(&tags, cmd);
+		run_step(&tags, "view 1");
+	}
+
+	for (i = 0; i < 10; i++)
+		run_step(&layouts, "switch_layout");
+
+	for (i = 0; i < 5; i++) {
+		run_step(&overview, "toggleoverview");
+		run_step(&overview, "toggleoverview");
+	}
+
+	run_step(&scroller, "setlayout scroller");
+	for (i = 0; i < nwindows; i++)
+		run_step(&scroller, "focusstack next");
+
+	printf("maomao-bench: %d windows, quiet period %dms\n", nwindows,
+		   quiet_ms);
+	printf("%-12s %6s %12s %10s %12s %12s\n", "scenario", "steps",
+		   "configures", "frames", "avg_ms", "max_ms");
+	print_result(&tags);
+	print_result(&layouts);
+	print_result(&overview);
+	print_result(&scroller);
+
+	cleanup();
+	return 0;
+}
@@ -0,0 +1,198 @@
+/*
+ * maomao-bench用的最小xdg-toplevel客户端.
+ * 一个连接里开N个窗口,每次收到configure就按新大小画一块纯色shm buffer,
+ * ack并提交,然后往stdout写一行"configure <CLOCK_MONOTONIC纳秒>",
+ * 所有窗口第一次提交完成后写一行"ready".
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+#include <wayland-client.h>
+
+#include "xdg-shell-client-protocol.h"
+
+typedef struct {
+	struct wl_surface *surface;
+	struct xdg_surface *xdg_surface;
+	struct xdg_toplevel *toplevel;
+	int width, height;
+	bool configured;
+} Window;
+
+static struct wl_compositor *compositor;
+static struct wl_shm *shm;
+static struct xdg_wm_base *wm_base;
+static Window *windows;
+static int nwindows, nconfigured;
+static bool running = true;
+
+static void die(const char *msg) {
+	fprintf(stderr, "maomao-bench-client: %s: %s\n", msg, strerror(errno));
+	exit(1);
+}
+
+static uint64_t monotonic_ns(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+static void buffer_release(void *data, struct wl_buffer *buffer) {
+	wl_buffer_destroy(buffer);
+}
+
+static const struct wl_buffer_listener buffer_listener = {
+	.release = buffer_release,
+};
+
+static struct wl_buffer *create_buffer(int width, int height) {
+	char name[64];
+	static unsigned int counter;
+	int fd, stride = width * 4, size = stride * height;
+	struct wl_shm_pool *pool;
+	struct wl_buffer *buffer;
+	uint32_t *pixels;
+	int i;
+
+	snprintf(name, sizeof(name), "/maomao-bench-%d-%u", getpid(), counter++);
+	if ((fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600)) < 0)
+		die("shm_open");
+	shm_unlink(name);
+	if (ftruncate(fd, size) < 0)
+		die("ftruncate");
+
+	pixels = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (pixels == MAP_FAILED)
+		die("mmap");
+	for (i = 0; i < width * height; i++)
+		pixels[i] = 0xff285577;
+	munmap(pixels, size);
+
+	pool = wl_shm_create_pool(shm, fd, size);
+	buffer = wl_shm_pool_create_buffer(pool, 0, width, height, stride,
+									   WL_SHM_FORMAT_XRGB8888);
+	wl_shm_pool_destroy(pool);
+	close(fd);
+	wl_buffer_add_listener(buffer, &buffer_listener, NULL);
+	return buffer;
+}
+
+static void xdg_surface_configure(void *data, struct xdg_surface *xdg_surface,
+								  uint32_t serial) {
+	Window *w = data;
+
+	xdg_surface_ack_configure(xdg_surface, serial);
+	wl_surface_attach(w->surface, create_buffer(w->width, w->height), 0, 0);
+	wl_surface_damage_buffer(w->surface, 0, 0, w->width, w->height);
+	wl_surface_commit(w->surface);
+
+	printf("configure %llu\n", (unsigned long long)monotonic_ns());
+	if (!w->configured) {
+		w->configured = true;
+		if (++nconfigured == nwindows)
+			printf("ready\n");
+	}
+	fflush(stdout);
+}
+
+static const struct xdg_surface_listener xdg_surface_listener = {
+	.configure = xdg_surface_configure,
+};
+
+static void toplevel_configure(void *data, struct xdg_toplevel *toplevel,
+							   int32_t width, int32_t height,
+							   struct wl_array *states) {
+	Window *w = data;
+
+	w->width = width > 0 ? width : 100;
+	w->height = height > 0 ? height : 100;
+}
+
+static void toplevel_close(void *data, struct xdg_toplevel *toplevel) {
+	running = false;
+}
+
+static const struct xdg_toplevel_listener toplevel_listener = {
+	.configure = toplevel_configure,
+	.close = toplevel_close,
+};
+
+static void wm_base_ping(void *data, struct xdg_wm_base *base,
+						 uint32_t serial) {
+	xdg_wm_base_pong(base, serial);
+}
+
+static const struct xdg_wm_base_listener wm_base_listener = {
+	.ping = wm_base_ping,
+};
+
+static void registry_global(void *data, struct wl_registry *registry,
+							uint32_t name, const char *interface,
+							uint32_t version) {
+	if (strcmp(interface, wl_compositor_interface.name) == 0) {
+		compositor =
+			wl_registry_bind(registry, name, &wl_compositor_interface, 4);
+	} else if (strcmp(interface, wl_shm_interface.name) == 0) {
+		shm = wl_registry_bind(registry, name, &wl_shm_interface, 1);
+	} else if (strcmp(interface, xdg_wm_base_interface.name) == 0) {
+		wm_base = wl_registry_bind(registry, name, &xdg_wm_base_interface, 1);
+		xdg_wm_base_add_listener(wm_base, &wm_base_listener, NULL);
+	}
+}
+
+static void registry_global_remove(void *data, struct wl_registry *registry,
+								   uint32_t name) {}
+
+static const struct wl_registry_listener registry_listener = {
+	.global = registry_global,
+	.global_remove = registry_global_remove,
+};
+
+int main(int argc, char *argv[]) {
+	struct wl_display *display;
+	struct wl_registry *registry;
+	Window *w;
+	int i;
+
+	nwindows = argc > 1 ? atoi(argv[1]) : 1;
+	if (nwindows < 1)
+		nwindows = 1;
+
+	if (!(display = wl_display_connect(NULL)))
+		die("wl_display_connect");
+	registry = wl_display_get_registry(display);
+	wl_registry_add_listener(registry, &registry_listener, NULL);
+	wl_display_roundtrip(display);
+	if (!compositor || !shm || !wm_base) {
+		fprintf(stderr, "maomao-bench-client: missing globals\n");
+		return 1;
+	}
+
+	windows = calloc(nwindows, sizeof(Window));
+	for (i = 0; i < nwindows; i++) {
+		w = &windows[i];
+		w->surface = wl_compositor_create_surface(compositor);
+		w->xdg_surface = xdg_wm_base_get_xdg_surface(wm_base, w->surface);
+		xdg_surface_add_listener(w->xdg_surface, &xdg_surface_listener, w);
+		w->toplevel = xdg_surface_get_toplevel(w->xdg_surface);
+		xdg_toplevel_add_listener(w->toplevel, &toplevel_listener, w);
+		xdg_toplevel_set_app_id(w->toplevel, "maomao-bench");
+		wl_surface_commit(w->surface);
+	}
+
+	while (running && wl_display_dispatch(display) != -1)
+		;
+
+	wl_display_disconnect(display);
+	free(windows);
+	return 0;
+}
@@ -610,31 +610,31 @@ void client_apply_clip(Client *c, float factor) {
 	buffer_set_effect(c, scale_data);
 }
 
-void fadeout_client_animation_next_tick(Client *c) {
-	if (!c)
+void fadeout_client_animation_next_tick(FadeoutSnapshot *s) {
+	if (!s)
 		return;
 
 	animationScale scale_data;
 
 	double animation_passed =
-		(double)c->animation.passed_frames / c->animation.total_frames;
-	int type = c->animation.action = c->animation.action;
+		(double)s->animation.passed_frames / s->animation.total_frames;
+	int type = s->animation.action = s->animation.action;
 	double factor = find_animation_curve_at(animation_passed, type);
 	unsigned int width =
-		c->animation.initial.width +
-		(c->current.width - c->animation.initial.width) * factor;
+		s->animation.initial.width +
+		(s->current.width - s->animation.initial.width) * factor;
 	unsigned int height =
-		c->animation.initial.height +
-		(c->current.height - c->animation.initial.height) * factor;
+		s->animation.initial.height +
+		(s->current.height - s->animation.initial.height) * factor;
 
-	unsigned int x = c->animation.initial.x +
-					 (c->current.x - c->animation.initial.x) * factor;
-	unsigned int y = c->animation.initial.y +
-					 (c->current.y - c->animation.initial.y) * factor;
+	unsigned int x = s->animation.initial.x +
+					 (s->current.x - s->animation.initial.x) * factor;
+	unsigned int y = s->animation.initial.y +
+					 (s->current.y - s->animation.initial.y) * factor;
 
-	wlr_scene_node_set_position(&c->scene->node, x, y);
+	wlr_scene_node_set_position(&s->scene->node, x, y);
 
-	c->animation.current = (struct wlr_box){
+	s->animation.current = (struct wlr_box){
 		.x = x,
 		.y = y,
 		.width = width,
@@ -643,13 +643,13 @@ void fadeout_client_animation_next_tick(Client *c) {
 
 	double opacity = MAX(fadeout_begin_opacity - animation_passed, 0);
 
-	if (animation_fade_out && !c->nofadeout)
-		wlr_scene_node_for_each_buffer(&c->scene->node,
+	if (animation_fade_out && !s->nofadeout)
+		wlr_scene_node_for_each_buffer(&s->scene->node,
 									   scene_buffer_apply_opacity, &opacity);
 
-	if ((c->animation_type_close &&
-		 strcmp(c->animation_type_close, "zoom") == 0) ||
-		(!c->animation_type_close &&
+	if ((s->animation_type_close &&
+		 strcmp(s->animation_type_close, "zoom") == 0) ||
+		(!s->animation_type_close &&
 		 strcmp(animation_type_close, "zoom") == 0)) {
 
 		scale_data.width = width;
@@ -658,16 +658,15 @@ void fadeout_client_animation_next_tick(Client *c) {
 		scale_data.height_scale = animation_passed;
 
 		wlr_scene_node_for_each_buffer(
-			&c->scene->node, snap_scene_buffer_apply_effect, &scale_data);
+			&s->scene->node, snap_scene_buffer_apply_effect, &scale_data);
 	}
 
 	if (animation_passed == 1.0) {
-		wl_list_remove(&c->fadeout_link);
-		wlr_scene_node_destroy(&c->scene->node);
-		free(c);
-		c = NULL;
+		wl_list_remove(&s->link);
+		wlr_scene_node_destroy(&s->scene->node);
+		fadeout_snapshot_put(s);
 	} else {
-		c->animation.passed_frames++;
+		s->animation.passed_frames++;
 	}
 }
 
@@ -706,6 +705,9 @@ void client_animation_next_tick(Client *c) {
 
 	if (animation_passed == 1.0) {
 
+		if (c->animation.action == OPEN)
+			launch_stats_animation_done(c);
+
 		// clear the open action state
 		// To prevent him from being mistaken that
 		// it's still in the opening animation in resize
@@ -755,7 +757,7 @@ void init_fadeout_client(Client *c) {
 		return;
 	}
 
-	Client *fadeout_cient = ecalloc(1, sizeof(*fadeout_cient));
+	FadeoutSnapshot *fadeout_cient = fadeout_snapshot_get();
 
 	wlr_scene_node_set_enabled(&c->scene->node, true);
 	client_set_border_color(c, bordercolor);
@@ -764,18 +766,15 @@ void init_fadeout_client(Client *c) {
 	wlr_scene_node_set_enabled(&c->scene->node, false);
 
 	if (!fadeout_cient->scene) {
-		free(fadeout_cient);
+		fadeout_snapshot_put(fadeout_cient);
 		return;
 	}
 
 	fadeout_cient->animation.duration = animation_duration_close;
-	fadeout_cient->geom = fadeout_cient->current =
-		fadeout_cient->animainit_geom = fadeout_cient->animation.initial =
-			c->animation.current;
-	fadeout_cient->mon = c->mon;
+	fadeout_cient->current = fadeout_cient->animation.initial =
+		c->animation.current;
 	fadeout_cient->animation_type_close = c->animation_type_close;
 	fadeout_cient->animation.action = CLOSE;
-	fadeout_cient->bw = c->bw;
 	fadeout_cient->nofadeout = c->nofadeout;
 
 	// 这里snap节点的坐标设置是使用的相对坐标，所以不能加上原来坐标
@@ -804,24 +803,24 @@ void init_fadeout_client(Client *c) {
 		fadeout_cient->current.x = 0; // x无偏差，垂直划出
 	} else {
 		fadeout_cient->current.y =
-			(fadeout_cient->geom.height -
-			 fadeout_cient->geom.height * zoom_end_ratio) /
+			(c->animation.current.height -
+			 c->animation.current.height * zoom_end_ratio) /
 			2;
 		fadeout_cient->current.x =
-			(fadeout_cient->geom.width -
-			 fadeout_cient->geom.width * zoom_end_ratio) /
+			(c->animation.current.width -
+			 c->animation.current.width * zoom_end_ratio) /
 			2;
 		fadeout_cient->current.width =
-			fadeout_cient->geom.width * zoom_end_ratio;
+			c->animation.current.width * zoom_end_ratio;
 		fadeout_cient->current.height =
-			fadeout_cient->geom.height * zoom_end_ratio;
+			c->animation.current.height * zoom_end_ratio;
 	}
 
 	fadeout_cient->animation.passed_frames = 0;
 	fadeout_cient->animation.total_frames =
 		fadeout_cient->animation.duration / output_frame_duration_ms();
 	wlr_scene_node_set_enabled(&fadeout_cient->scene->node, true);
-	wl_list_insert(&fadeout_clients, &fadeout_cient->fadeout_link);
+	wl_list_insert(&fadeout_clients, &fadeout_cient->link);
 
 	// 请求刷新屏幕
 	wlr_output_schedule_frame(c->mon->wlr_output);
@@ -896,6 +895,7 @@ void resize(Client *c, struct wlr_box geo, int interact) {
 
 	struct wlr_box *bbox;
 	struct wlr_box clip;
+	uint32_t serial;
 
 	if (!c->mon)
 		return;
@@ -919,6 +919,9 @@ void resize(Client *c, struct wlr_box geo, int interact) {
 			bbox); // 去掉这个推荐的窗口大小,因为有时推荐的窗口特别大导致平铺异常
 	}
 
+	spatial_index_invalidate();
+	scene_generation++;
+
 	if (!c->is_pending_open_animation) {
 		c->animation.begin_fade_in = false;
 	}
@@ -957,8 +960,13 @@ void resize(Client *c, struct wlr_box geo, int interact) {
 	}
 
 	// c->geom 是真实的窗口大小和位置，跟过度的动画无关，用于计算布局
-	c->configure_serial = client_set_size(c, c->geom.width - 2 * c->bw,
-										  c->geom.height - 2 * c->bw);
+	// 大小没变时不会发送configure,保留之前还在等待ack的serial
+	serial = client_set_size(c, c->geom.width - 2 * c->bw,
+							 c->geom.height - 2 * c->bw);
+	if (serial) {
+		c->configure_serial = serial;
+		client_stats_configure(c, serial);
+	}
 
 	if (c == grabc) {
 		c->animation.running = false;
@@ -998,11 +1006,11 @@ void resize(Client *c, struct wlr_box geo, int interact) {
 	setborder_color(c);
 }
 
-bool client_draw_fadeout_frame(Client *c) {
-	if (!c)
+bool client_draw_fadeout_frame(FadeoutSnapshot *s) {
+	if (!s)
 		return false;
 
-	fadeout_client_animation_next_tick(c);
+	fadeout_client_animation_next_tick(s);
 	return true;
 }
 
@@ -1022,6 +1030,8 @@ bool client_draw_frame(Client *c) {
 	if (!c->need_output_flush)
 		return false;
 
+	scene_generation++;
+
 	if (animations && c->animation.running) {
 		client_animation_next_tick(c);
 	} else {
@@ -230,4 +230,28 @@ struct wlr_scene_tree *wlr_scene_tree_snapshot(struct wlr_scene_node *node,
 	wlr_scene_node_set_enabled(&snapshot->node, true);
 
 	return snapshot;
-}
\ No newline at end of file
+}
+#define FADEOUT_POOL_MAX 32 /* 池里最多留这么多个空闲快照 */
+
+FadeoutSnapshot *fadeout_snapshot_get(void) {
+	FadeoutSnapshot *s;
+
+	if (wl_list_empty(&fadeout_pool))
+		return ecalloc(1, sizeof(*s));
+
+	s = wl_container_of(fadeout_pool.next, s, link);
+	wl_list_remove(&s->link);
+	fadeout_pool_size--;
+	memset(s, 0, sizeof(*s));
+	return s;
+}
+
+// 动画结束后调用,一次关很多窗口时多出来的直接释放
+void fadeout_snapshot_put(FadeoutSnapshot *s) {
+	if (fadeout_pool_size >= FADEOUT_POOL_MAX) {
+		free(s);
+		return;
+	}
+	wl_list_insert(&fadeout_pool, &s->link);
+	fadeout_pool_size++;
+}
@@ -230,42 +230,42 @@ void layer_fadeout_scene_buffer_apply_effect(struct wlr_scene_buffer *buffer,
 								   scale_data->height);
 }
 
-void fadeout_layer_animation_next_tick(LayerSurface *l) {
-	if (!l)
+void fadeout_layer_animation_next_tick(FadeoutSnapshot *s) {
+	if (!s)
 		return;
 
 	double animation_passed =
-		(double)l->animation.passed_frames / l->animation.total_frames;
-	int type = l->animation.action = l->animation.action;
+		(double)s->animation.passed_frames / s->animation.total_frames;
+	int type = s->animation.action = s->animation.action;
 	double factor = find_animation_curve_at(animation_passed, type);
 	unsigned int width =
-		l->animation.initial.width +
-		(l->current.width - l->animation.initial.width) * factor;
+		s->animation.initial.width +
+		(s->current.width - s->animation.initial.width) * factor;
 	unsigned int height =
-		l->animation.initial.height +
-		(l->current.height - l->animation.initial.height) * factor;
+		s->animation.initial.height +
+		(s->current.height - s->animation.initial.height) * factor;
 
-	unsigned int x = l->animation.initial.x +
-					 (l->current.x - l->animation.initial.x) * factor;
-	unsigned int y = l->animation.initial.y +
-					 (l->current.y - l->animation.initial.y) * factor;
+	unsigned int x = s->animation.initial.x +
+					 (s->current.x - s->animation.initial.x) * factor;
+	unsigned int y = s->animation.initial.y +
+					 (s->current.y - s->animation.initial.y) * factor;
 
-	wlr_scene_node_set_position(&l->scene->node, x, y);
+	wlr_scene_node_set_position(&s->scene->node, x, y);
 
 	animationScale scale_data;
 	scale_data.width = width;
 	scale_data.height = height;
 
-	if ((!l->animation_type_close &&
+	if ((!s->animation_type_close &&
 		 strcmp(layer_animation_type_close, "zoom") == 0) ||
-		(l->animation_type_close &&
-		 strcmp(l->animation_type_close, "zoom") == 0)) {
-		wlr_scene_node_for_each_buffer(&l->scene->node,
+		(s->animation_type_close &&
+		 strcmp(s->animation_type_close, "zoom") == 0)) {
+		wlr_scene_node_for_each_buffer(&s->scene->node,
 									   layer_fadeout_scene_buffer_apply_effect,
 									   &scale_data);
 	}
 
-	l->animation.current = (struct wlr_box){
+	s->animation.current = (struct wlr_box){
 		.x = x,
 		.y = y,
 		.width = width,
@@ -275,16 +275,15 @@ void fadeout_layer_animation_next_tick(LayerSurface *l) {
 	double opacity = MAX(fadeout_begin_opacity - animation_passed, 0.0f);
 
 	if (animation_fade_out)
-		wlr_scene_node_for_each_buffer(&l->scene->node,
+		wlr_scene_node_for_each_buffer(&s->scene->node,
 									   scene_buffer_apply_opacity, &opacity);
 
 	if (animation_passed == 1.0) {
-		wl_list_remove(&l->fadeout_link);
-		wlr_scene_node_destroy(&l->scene->node);
-		free(l);
-		l = NULL;
+		wl_list_remove(&s->link);
+		wlr_scene_node_destroy(&s->scene->node);
+		fadeout_snapshot_put(s);
 	} else {
-		l->animation.passed_frames++;
+		s->animation.passed_frames++;
 	}
 }
 
@@ -372,7 +371,7 @@ void init_fadeout_layers(LayerSurface *l) {
 		l->layer_surface->current.layer == ZWLR_LAYER_SHELL_V1_LAYER_BACKGROUND)
 		return;
 
-	LayerSurface *fadeout_layer = ecalloc(1, sizeof(*fadeout_layer));
+	FadeoutSnapshot *fadeout_layer = fadeout_snapshot_get();
 
 	struct wlr_box usable_area;
 	get_layer_area_bound(l, &usable_area);
@@ -383,18 +382,15 @@ void init_fadeout_layers(LayerSurface *l) {
 	wlr_scene_node_set_enabled(&l->scene->node, false);
 
 	if (!fadeout_layer->scene) {
-		free(fadeout_layer);
+		fadeout_snapshot_put(fadeout_layer);
 		return;
 	}
 
 	fadeout_layer->animation.duration = animation_duration_close;
-	fadeout_layer->geom = fadeout_layer->current =
-		fadeout_layer->animainit_geom = fadeout_layer->animation.initial =
-			l->animation.current;
-	fadeout_layer->mon = l->mon;
+	fadeout_layer->current = fadeout_layer->animation.initial =
+		l->animation.current;
 	fadeout_layer->animation.action = CLOSE;
 	fadeout_layer->animation_type_close = l->animation_type_close;
-	fadeout_layer->animation_type_open = l->animation_type_open;
 
 	// 这里snap节点的坐标设置是使用的相对坐标，不能用绝对坐标
 	// 这跟普通node有区别
@@ -449,7 +445,7 @@ void init_fadeout_layers(LayerSurface *l) {
 
 	// 将节点插入到关闭动画链表中，屏幕刷新哪里会检查链表中是否有节点可以应用于动画
 	wlr_scene_node_set_enabled(&fadeout_layer->scene->node, true);
-	wl_list_insert(&fadeout_layers, &fadeout_layer->fadeout_link);
+	wl_list_insert(&fadeout_layers, &fadeout_layer->link);
 
 	// 请求刷新屏幕
 	wlr_output_schedule_frame(l->mon->wlr_output);
@@ -563,6 +559,8 @@ bool layer_draw_frame(LayerSurface *l) {
 		return false;
 	}
 
+	scene_generation++;
+
 	if (animations && layer_animations && l->animation.running && !l->noanim) {
 		layer_animation_next_tick(l);
 		layer_draw_shadow(l);
@@ -573,10 +571,10 @@ bool layer_draw_frame(LayerSurface *l) {
 	return true;
 }
 
-bool layer_draw_fadeout_frame(LayerSurface *l) {
-	if (!l)
+bool layer_draw_fadeout_frame(FadeoutSnapshot *s) {
+	if (!s)
 		return false;
 
-	fadeout_layer_animation_next_tick(l);
+	fadeout_layer_animation_next_tick(s);
 	return true;
 }
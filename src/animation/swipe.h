@@ -0,0 +1,505 @@
+/*
+ * 触控板连续手势.配置了swipe_continuous_fingers之后,这么多手指沿跟踪方向
+ * 滑动时窗口直接跟着手指移动:普通布局下把相邻标签拖进来,
+ * scroller布局下平移视口.跟手的过程中只移动场景节点和更新剪切,
+ * 不给客户端发configure.松手时根据位移和速度决定切换还是弹回,
+ * 剩下的距离交给原来的标签/移动动画完成.
+ * 方向跟标签动画一致,vertical_scroller为纵向,另一个方向的滑动仍然走手势绑定.
+ *
+ * axisbind绑定到scroller_pan时滚动也走同一套scroller平移:跟着delta逐像素移动,
+ * 触控板抬起手指(axis stop)后按松手速度做惯性滑动,
+ * 停下来以后才选出新的焦点列并arrange一次.
+ */
+
+#define SWIPE_TRACK_LOCK 10		   /* 滑动这么多像素后才确定方向 */
+#define SWIPE_TRACK_FLING 0.5	   /* 像素/毫秒,超过这个速度松手直接切换 */
+#define SWIPE_TRACK_IDLE_MS 50	   /* 松手前停顿这么久速度按0算 */
+#define SWIPE_TRACK_PROJECT_MS 150 /* scroller松手后按速度继续滑的时间 */
+#define SCROLLER_PAN_SETTLE_MS 150 /* 滚轮停下这么久后结束平移 */
+#define SCROLLER_PAN_TICK_MS 8		/* 惯性滑动的步进间隔 */
+#define SCROLLER_PAN_DECAY_MS 325.0 /* 惯性速度衰减的时间常数 */
+#define SCROLLER_PAN_STOP 0.02		/* 像素/毫秒,惯性低于这个速度就停 */
+
+/* Aborted: 跟踪到一半被arrange收掉了,这次滑动到抬手之前都算已经用掉 */
+enum {
+	SwipeTrackNone,
+	SwipeTrackArmed,
+	SwipeTrackTag,
+	SwipeTrackScroller,
+	SwipeTrackAborted
+};
+
+static struct {
+	int mode;
+	Monitor *m;
+	bool vertical;
+	double offset;	 /* 沿跟踪方向的累计位移 */
+	double velocity; /* 像素/毫秒 */
+	uint32_t last_time_msec;
+	unsigned int neighbor; /* 被拖进来的标签,从1开始,0为没有 */
+	bool axis;			   /* 滚轮/滚动驱动的scroller平移 */
+	bool kinetic;		   /* 正在惯性滑动 */
+	uint64_t tick_ns;
+	struct wl_event_source *timer;
+} swipe_track;
+
+static void swipe_track_finish_scroller(bool cancelled);
+
+static bool swipe_track_skip(Client *c) {
+	return c->iskilling || c->isglobal || c->isunglobal ||
+		   !client_surface(c)->mapped;
+}
+
+// 接管窗口:停掉还在进行的动画,之后由手势决定位置
+static void swipe_track_take(Client *c) {
+	c->animation.running = false;
+	c->animation.tagouting = false;
+	c->animation.tagining = true; // 让clip_to_hide剪掉超出显示器的部分
+	c->need_output_flush = false;
+}
+
+static void swipe_track_place(Client *c, int x, int y) {
+	c->animation.current = c->geom;
+	c->animation.current.x = x;
+	c->animation.current.y = y;
+	wlr_scene_node_set_position(&c->scene->node, x, y);
+	client_apply_clip(c, 1.0);
+}
+
+// 相邻标签的窗口在标签切换完成后的位置,也就是它们被拖进来之前的位置
+static void swipe_track_neighbor_base(Client *c, int *x, int *y) {
+	Monitor *m = swipe_track.m;
+	int sign = swipe_track.neighbor > m->pertag->curtag ? 1 : -1;
+
+	*x = c->geom.x + (swipe_track.vertical ? 0 : sign * m->m.width);
+	*y = c->geom.y + (swipe_track.vertical ? sign * m->m.height : 0);
+}
+
+static void swipe_track_hide_neighbor(void) {
+	Monitor *m = swipe_track.m;
+	TagLink *tl;
+	Client *c;
+
+	if (!swipe_track.neighbor)
+		return;
+	wl_list_for_each(tl, &m->pertag->tag_clients[swipe_track.neighbor - 1],
+					 link) {
+		c = tl->c;
+		if (swipe_track_skip(c) || VISIBLEON(c, m))
+			continue;
+		c->animation.tagining = false;
+		c->animation.tagouted = true;
+		wlr_scene_node_set_enabled(&c->scene->node, false);
+	}
+	swipe_track.neighbor = 0;
+}
+
+static void swipe_track_update_tag(void) {
+	Monitor *m = swipe_track.m;
+	unsigned int curtag = m->pertag->curtag, neighbor;
+	double offset = swipe_track.offset;
+	int dx, dy, x, y;
+	TagLink *tl;
+	Client *c;
+
+	// 手指往左(上)拖出来的是下一个标签
+	neighbor = offset < 0 ? curtag + 1 : curtag - 1;
+	if (neighbor < 1 || neighbor > LENGTH(tags) || offset == 0)
+		neighbor = 0;
+	if (neighbor != swipe_track.neighbor) {
+		swipe_track_hide_neighbor();
+		swipe_track.neighbor = neighbor;
+		if (neighbor) {
+			wl_list_for_each(tl, &m->pertag->tag_clients[neighbor - 1], link) {
+				if (!swipe_track_skip(tl->c) && !VISIBLEON(tl->c, m))
+					swipe_track_take(tl->c);
+			}
+		}
+	}
+	// 两头没有标签了,只给一点阻力感
+	if (!neighbor)
+		offset /= 3;
+
+	dx = swipe_track.vertical ? 0 : (int)round(offset);
+	dy = swipe_track.vertical ? (int)round(offset) : 0;
+
+	wl_list_for_each(tl, &m->pertag->tag_clients[curtag - 1], link) {
+		c = tl->c;
+		if (swipe_track_skip(c) ||
+			(neighbor && (c->tags & (1 << (neighbor - 1)))))
+			continue;
+		swipe_track_place(c, c->geom.x + dx, c->geom.y + dy);
+	}
+
+	if (!neighbor)
+		return;
+	wl_list_for_each(tl, &m->pertag->tag_clients[neighbor - 1], link) {
+		c = tl->c;
+		if (swipe_track_skip(c) || VISIBLEON(c, m))
+			continue;
+		swipe_track_neighbor_base(c, &x, &y);
+		c->is_clip_to_hide = false;
+		wlr_scene_node_set_enabled(&c->scene->node, true);
+		swipe_track_place(c, x + dx, y + dy);
+	}
+}
+
+static void swipe_track_update_scroller(void) {
+	Monitor *m = swipe_track.m;
+	int d = (int)round(swipe_track.offset);
+	Client *c;
+
+	wl_list_for_each(c, &clients, link) {
+		if (!VISIBLEON(c, m) || !ISTILED(c) || swipe_track_skip(c))
+			continue;
+		swipe_track_place(c, c->geom.x + (swipe_track.vertical ? 0 : d),
+						  c->geom.y + (swipe_track.vertical ? d : 0));
+	}
+}
+
+static bool swipe_track_scroller_vertical(Monitor *m) {
+	return strcmp(m->pertag->ltidxs[m->pertag->curtag]->name,
+				  "vertical_scroller") == 0;
+}
+
+static void swipe_track_take_scroller(Monitor *m) {
+	Client *c;
+
+	swipe_track.mode = SwipeTrackScroller;
+	swipe_track.axis = false;
+	swipe_track.kinetic = false;
+	wl_list_for_each(c, &clients, link) {
+		if (VISIBLEON(c, m) && ISTILED(c) && !swipe_track_skip(c)) {
+			swipe_track_take(c);
+			c->animation.tagining = false;
+		}
+	}
+}
+
+// 确定了跟踪方向,接管当前视图上的窗口
+static void swipe_track_lock(void) {
+	Monitor *m = selmon;
+	bool vertical = fabs(swipe_dy) > fabs(swipe_dx);
+	TagLink *tl;
+
+	swipe_track.mode = SwipeTrackNone;
+	swipe_track.axis = false;
+	if (!m || m->isoverview || locked || !animations)
+		return;
+
+	if (is_scroller_layout(m)) {
+		if (vertical != swipe_track_scroller_vertical(m))
+			return;
+		swipe_track_take_scroller(m);
+	} else {
+		if (!m->pertag->curtag || vertical != (tag_animation_direction ==
+											   VERTICAL))
+			return;
+		swipe_track.mode = SwipeTrackTag;
+		wl_list_for_each(tl, &m->pertag->tag_clients[m->pertag->curtag - 1],
+						 link) {
+			if (!swipe_track_skip(tl->c))
+				swipe_track_take(tl->c);
+		}
+	}
+
+	swipe_track.m = m;
+	swipe_track.vertical = vertical;
+	swipe_track.offset = vertical ? swipe_dy : swipe_dx;
+	swipe_track.neighbor = 0;
+}
+
+void swipe_track_begin(unsigned int fingers, uint32_t time_msec) {
+	// 滚动平移还没停下来就开始了新的手势,先就地结束
+	if (swipe_track.mode == SwipeTrackScroller && swipe_track.axis) {
+		swipe_track.velocity = 0;
+		swipe_track_finish_scroller(false);
+	}
+	swipe_track.mode = swipe_continuous_fingers &&
+							   fingers == swipe_continuous_fingers
+						   ? SwipeTrackArmed
+						   : SwipeTrackNone;
+	swipe_track.velocity = 0;
+	swipe_track.last_time_msec = time_msec;
+}
+
+// swipe_dx/swipe_dy已经累加过这次的位移
+void swipe_track_update(double dx, double dy, uint32_t time_msec) {
+	double d, dt;
+
+	if (swipe_track.mode == SwipeTrackNone ||
+		swipe_track.mode == SwipeTrackAborted)
+		return;
+
+	if (swipe_track.mode == SwipeTrackArmed) {
+		if (fabs(swipe_dx) + fabs(swipe_dy) < SWIPE_TRACK_LOCK)
+			return;
+		swipe_track_lock();
+	} else {
+		d = swipe_track.vertical ? dy : dx;
+		swipe_track.offset += d;
+		dt = time_msec - swipe_track.last_time_msec;
+		if (dt > 0)
+			swipe_track.velocity = 0.6 * d / dt + 0.4 * swipe_track.velocity;
+	}
+	swipe_track.last_time_msec = time_msec;
+
+	if (swipe_track.mode == SwipeTrackTag)
+		swipe_track_update_tag();
+	else if (swipe_track.mode == SwipeTrackScroller)
+		swipe_track_update_scroller();
+}
+
+/* 根据剩下的距离和松手时朝目标方向的速度估算收尾动画的时长,
+ * 不超过正常的动画时长 */
+static uint32_t swipe_track_snap_duration(double remaining, double toward,
+										  double full, uint32_t duration) {
+	double ms = toward > 0.05 ? remaining / toward
+							  : duration * remaining / MAX(full, 1.0);
+
+	return (uint32_t)MAX(MIN(ms, (double)duration), duration / 4.0);
+}
+
+static void swipe_track_finish_tag(bool cancelled) {
+	Monitor *m = swipe_track.m;
+	double full = swipe_track.vertical ? m->m.height : m->m.width;
+	double dir = swipe_track.offset < 0 ? -1 : 1;
+	double toward = swipe_track.velocity * dir;
+	unsigned int neighbor = swipe_track.neighbor, curtag = m->pertag->curtag;
+	uint32_t saved = animation_duration_tag;
+	bool commit;
+	int x, y;
+	TagLink *tl;
+	Client *c;
+
+	commit = neighbor && !cancelled &&
+			 (fabs(swipe_track.offset) > full / 2 ||
+			  toward > SWIPE_TRACK_FLING);
+
+	swipe_track.mode = SwipeTrackNone;
+	animation_duration_tag = swipe_track_snap_duration(
+		commit ? full - fabs(swipe_track.offset) : fabs(swipe_track.offset),
+		commit ? toward : -toward, full, saved);
+
+	if (commit) {
+		// 标签动画从拖到的位置开始,见arrange_client
+		wl_list_for_each(tl, &m->pertag->tag_clients[neighbor - 1], link) {
+			if (!swipe_track_skip(tl->c) && !VISIBLEON(tl->c, m))
+				tl->c->animation.running = true;
+		}
+		view_in_mon(&(Arg){.ui = 1 << (neighbor - 1)}, true, m);
+		animation_duration_tag = saved;
+		return;
+	}
+
+	// 弹回:当前标签的窗口回到原位,拖进来的窗口退出去后隐藏
+	wl_list_for_each(tl, &m->pertag->tag_clients[curtag - 1], link) {
+		c = tl->c;
+		if (swipe_track_skip(c) || !c->animation.tagining)
+			continue;
+		c->current = c->animainit_geom = c->animation.current;
+		resize(c, c->geom, 0);
+	}
+	if (neighbor) {
+		wl_list_for_each(tl, &m->pertag->tag_clients[neighbor - 1], link) {
+			c = tl->c;
+			if (swipe_track_skip(c) || VISIBLEON(c, m))
+				continue;
+			swipe_track_neighbor_base(c, &x, &y);
+			c->animation.tagining = false;
+			c->animation.tagouting = true;
+			c->current = c->animation.current;
+			c->pending = c->geom;
+			c->pending.x = x;
+			c->pending.y = y;
+			resize(c, c->geom, 0);
+		}
+	}
+	swipe_track.neighbor = 0;
+	animation_duration_tag = saved;
+}
+
+static void swipe_track_finish_scroller(bool cancelled) {
+	Monitor *m = swipe_track.m;
+	double full = swipe_track.vertical ? m->w.height : m->w.width;
+	double project = swipe_track.offset;
+	double center, pos, dist, best_dist = 0;
+	uint32_t saved = animation_duration_move;
+	Client *c, *target = NULL;
+
+	// 取消时全部弹回原位
+	if (cancelled)
+		project = 0;
+	else
+		project += swipe_track.velocity * SWIPE_TRACK_PROJECT_MS;
+	center = swipe_track.vertical ? m->w.y + m->w.height / 2.0
+								  : m->w.x + m->w.width / 2.0;
+
+	// 松手后离显示器中间最近的窗口成为新的焦点,scroller会以它为准重新排列
+	wl_list_for_each(c, &clients, link) {
+		if (!VISIBLEON(c, m) || !ISTILED(c) || swipe_track_skip(c))
+			continue;
+		c->current = c->animainit_geom = c->animation.current;
+		pos = swipe_track.vertical ? c->geom.y + c->geom.height / 2.0
+								   : c->geom.x + c->geom.width / 2.0;
+		dist = fabs(pos + project - center);
+		if (!target || dist < best_dist) {
+			best_dist = dist;
+			target = c;
+		}
+	}
+
+	swipe_track.mode = SwipeTrackNone;
+	swipe_track.kinetic = false;
+	if (swipe_track.timer)
+		wl_event_source_timer_update(swipe_track.timer, 0);
+	if (cancelled && m->sel && VISIBLEON(m->sel, m) && ISTILED(m->sel))
+		target = m->sel;
+	if (!target)
+		return;
+
+	if (swipe_track.vertical)
+		target->geom.y += (int)round(project);
+	else
+		target->geom.x += (int)round(project);
+
+	animation_duration_move = swipe_track_snap_duration(
+		fabs(project - swipe_track.offset) + best_dist,
+		fabs(swipe_track.velocity), full, saved);
+	if (target != m->sel)
+		focusclient(target, 1);
+	arrange(m, false);
+	animation_duration_move = saved;
+}
+
+// 返回true表示这次滑动被连续手势用掉了,不再触发手势绑定
+bool swipe_track_end(bool cancelled, uint32_t time_msec) {
+	if (swipe_track.mode == SwipeTrackAborted) {
+		swipe_track.mode = SwipeTrackNone;
+		return true;
+	}
+	if (swipe_track.mode != SwipeTrackTag &&
+		swipe_track.mode != SwipeTrackScroller) {
+		swipe_track.mode = SwipeTrackNone;
+		return false;
+	}
+
+	if (time_msec - swipe_track.last_time_msec > SWIPE_TRACK_IDLE_MS)
+		swipe_track.velocity = 0;
+	if (swipe_track.mode == SwipeTrackTag)
+		swipe_track_finish_tag(cancelled);
+	else
+		swipe_track_finish_scroller(cancelled);
+	return true;
+}
+
+// 跟踪过程中显示器要重新arrange(比如有窗口打开或关闭),先把手势收掉
+void swipe_track_abort(Monitor *m) {
+	if (swipe_track.m != m || (swipe_track.mode != SwipeTrackTag &&
+							   swipe_track.mode != SwipeTrackScroller))
+		return;
+	if (swipe_track.mode == SwipeTrackTag)
+		swipe_track_finish_tag(true);
+	// 滚轮平移没有抬手事件,手指滑动要等swipe_end才算结束
+	swipe_track.mode = swipe_track.axis ? SwipeTrackNone : SwipeTrackAborted;
+}
+
+// 滚轮停下来了,或者惯性滑动的下一步
+static int scroller_pan_tick(void *data) {
+	uint64_t now = monotonic_ns();
+	double dt = (now - swipe_track.tick_ns) / 1e6;
+
+	if (swipe_track.mode != SwipeTrackScroller || !swipe_track.axis)
+		return 0;
+
+	if (!swipe_track.kinetic) {
+		swipe_track.velocity = 0;
+		swipe_track_finish_scroller(false);
+		return 0;
+	}
+
+	swipe_track.tick_ns = now;
+	swipe_track.offset += swipe_track.velocity * dt;
+	swipe_track.velocity *= exp(-dt / SCROLLER_PAN_DECAY_MS);
+	swipe_track_update_scroller();
+
+	if (fabs(swipe_track.velocity) < SCROLLER_PAN_STOP) {
+		swipe_track.velocity = 0;
+		swipe_track_finish_scroller(false);
+	} else {
+		wl_event_source_timer_update(swipe_track.timer, SCROLLER_PAN_TICK_MS);
+	}
+	return 0;
+}
+
+static bool scroller_pan_start(void) {
+	Monitor *m = selmon;
+
+	if (swipe_track.mode == SwipeTrackScroller && swipe_track.axis &&
+		swipe_track.m == m)
+		return true;
+	// 手指滑动正在跟踪时不处理滚动
+	if (swipe_track.mode != SwipeTrackNone || !m || m->isoverview || locked ||
+		!animations || !is_scroller_layout(m))
+		return false;
+	if (!swipe_track.timer &&
+		!(swipe_track.timer =
+			  wl_event_loop_add_timer(event_loop, scroller_pan_tick, NULL)))
+		return false;
+
+	swipe_track_take_scroller(m);
+	swipe_track.axis = true;
+	swipe_track.m = m;
+	swipe_track.vertical = swipe_track_scroller_vertical(m);
+	swipe_track.offset = 0;
+	swipe_track.velocity = 0;
+	swipe_track.neighbor = 0;
+	return true;
+}
+
+static void scroller_pan_kinetic(double velocity) {
+	swipe_track.kinetic = true;
+	swipe_track.velocity = velocity;
+	swipe_track.tick_ns = monotonic_ns();
+	wl_event_source_timer_update(swipe_track.timer, SCROLLER_PAN_TICK_MS);
+}
+
+// axisnotify里绑定到scroller_pan的滚动事件,不受axis_bind_apply_timeout限制
+void scroller_axis_pan(struct wlr_pointer_axis_event *event) {
+	double dt;
+
+	if (!scroller_pan_start())
+		return;
+
+	// 触控板抬起手指,按最后的速度惯性滑动
+	if (event->delta == 0) {
+		if (event->source == WL_POINTER_AXIS_SOURCE_FINGER &&
+			event->time_msec - swipe_track.last_time_msec <=
+				SWIPE_TRACK_IDLE_MS)
+			scroller_pan_kinetic(swipe_track.velocity);
+		else
+			wl_event_source_timer_update(swipe_track.timer, 1);
+		return;
+	}
+
+	// 往下(右)滚动看后面的列,窗口往反方向移动
+	swipe_track.kinetic = false;
+	swipe_track.offset -= event->delta;
+	dt = event->time_msec - swipe_track.last_time_msec;
+	if (dt > 0 && dt < SWIPE_TRACK_IDLE_MS)
+		swipe_track.velocity =
+			0.6 * -event->delta / dt + 0.4 * swipe_track.velocity;
+	else
+		swipe_track.velocity = 0;
+	swipe_track.last_time_msec = event->time_msec;
+	swipe_track_update_scroller();
+	wl_event_source_timer_update(swipe_track.timer, SCROLLER_PAN_SETTLE_MS);
+}
+
+/* 不是从滚动调用的时候(比如键盘绑定),按arg->i像素惯性平移,
+ * 初速度取i/衰减时间常数,滑完正好是i像素 */
+void scroller_pan(const Arg *arg) {
+	if (!arg->i || !scroller_pan_start())
+		return;
+	scroller_pan_kinetic(swipe_track.velocity + arg->i / SCROLLER_PAN_DECAY_MS);
+}
@@ -110,9 +110,9 @@ static inline uint32_t client_set_bounds(Client *c, int32_t width,
 	if (wl_resource_get_version(c->surface.xdg->toplevel->resource) >=
 			XDG_TOPLEVEL_CONFIGURE_BOUNDS_SINCE_VERSION &&
 		width >= 0 && height >= 0 &&
-		(c->bounds.width != width || c->bounds.height != height)) {
-		c->bounds.width = width;
-		c->bounds.height = height;
+		(c->cold->bounds.width != width || c->cold->bounds.height != height)) {
+		c->cold->bounds.width = width;
+		c->cold->bounds.height = height;
 		return wlr_xdg_toplevel_set_bounds(c->surface.xdg->toplevel, width,
 										   height);
 	}
@@ -330,13 +330,31 @@ static inline uint32_t client_set_size(Client *c, uint32_t width,
 									   uint32_t height) {
 #ifdef XWAYLAND
 	if (client_is_x11(c)) {
-		wlr_xwayland_surface_configure(c->surface.xwayland, c->geom.x + c->bw,
-									   c->geom.y + c->bw, width, height);
+		struct wlr_xwayland_surface *xsurface = c->surface.xwayland;
+		int16_t x = c->geom.x + c->bw, y = c->geom.y + c->bw;
+
+		if (width == xsurface->width && height == xsurface->height) {
+			if (x == xsurface->x && y == xsurface->y)
+				return 0;
+			/* 拖动和划出工作区时只是过渡位置,只移动场景节点,
+			 * 除非窗口跨越了输出,最终位置在松开时再同步 */
+			if ((c == grabc || c->animation.tagouting) &&
+				wlr_output_layout_output_at(
+					output_layout, xsurface->x + xsurface->width / 2.0,
+					xsurface->y + xsurface->height / 2.0) ==
+					wlr_output_layout_output_at(output_layout,
+												x + width / 2.0,
+												y + height / 2.0))
+				return 0;
+		}
+		wlr_xwayland_surface_configure(xsurface, x, y, width, height);
 		return 0;
 	}
 #endif
-	if ((int32_t)width == c->surface.xdg->toplevel->current.width &&
-		(int32_t)height == c->surface.xdg->toplevel->current.height)
+	/* 与已经请求过的大小一致(包括还没ack的configure),
+	 * 说明只是位置变化,不需要让客户端重新布局 */
+	if ((int32_t)width == c->surface.xdg->toplevel->scheduled.width &&
+		(int32_t)height == c->surface.xdg->toplevel->scheduled.height)
 		return 0;
 	return wlr_xdg_toplevel_set_size(c->surface.xdg->toplevel, (int32_t)width,
 									 (int32_t)height);
@@ -0,0 +1,206 @@
+/*
+ * 可见窗口的几何索引,给方向焦点,浮动窗口吸附和smartmovewin这类
+ * 需要找"某个方向上最近的窗口"的操作使用.
+ * 每个数组按一条边排序,几何或者可见性变化时只标记失效,
+ * 下一次查询的时候再重建.
+ */
+
+typedef struct {
+	int key, key2; /* 排序用的边,相同时按另一个轴排序 */
+	Client *c;
+} SpatialEdge;
+
+/* 数组在重建时可能重新分配,调用者传这个,不要传数组指针 */
+enum { SpatialLeft, SpatialRight, SpatialTop, SpatialBottom };
+
+static struct {
+	SpatialEdge *left;	 /* geom.x, geom.y */
+	SpatialEdge *right;	 /* geom.x + geom.width, geom.y */
+	SpatialEdge *top;	 /* geom.y, geom.x */
+	SpatialEdge *bottom; /* geom.y + geom.height, geom.x */
+	unsigned int len, cap;
+	unsigned int serial;
+} spatial_index;
+
+static unsigned int geometry_serial = 1;
+
+void spatial_index_invalidate(void) { geometry_serial++; }
+
+static int spatial_edge_cmp(const void *a, const void *b) {
+	const SpatialEdge *ea = a, *eb = b;
+
+	if (ea->key != eb->key)
+		return ea->key < eb->key ? -1 : 1;
+	if (ea->key2 != eb->key2)
+		return ea->key2 < eb->key2 ? -1 : 1;
+	return 0;
+}
+
+void spatial_index_update(void) {
+	Client *c;
+	unsigned int n = 0;
+
+	if (spatial_index.serial == geometry_serial)
+		return;
+
+	wl_list_for_each(c, &clients, link) {
+		if (!c->iskilling && VISIBLEON(c, c->mon))
+			n++;
+	}
+
+	if (n > spatial_index.cap) {
+		spatial_index.cap = MAX(n, spatial_index.cap * 2);
+		free(spatial_index.left);
+		free(spatial_index.right);
+		free(spatial_index.top);
+		free(spatial_index.bottom);
+		spatial_index.left = ecalloc(spatial_index.cap, sizeof(SpatialEdge));
+		spatial_index.right = ecalloc(spatial_index.cap, sizeof(SpatialEdge));
+		spatial_index.top = ecalloc(spatial_index.cap, sizeof(SpatialEdge));
+		spatial_index.bottom = ecalloc(spatial_index.cap, sizeof(SpatialEdge));
+	}
+
+	n = 0;
+	wl_list_for_each(c, &clients, link) {
+		if (c->iskilling || !VISIBLEON(c, c->mon))
+			continue;
+		spatial_index.left[n] = (SpatialEdge){c->geom.x, c->geom.y, c};
+		spatial_index.right[n] =
+			(SpatialEdge){c->geom.x + c->geom.width, c->geom.y, c};
+		spatial_index.top[n] = (SpatialEdge){c->geom.y, c->geom.x, c};
+		spatial_index.bottom[n] =
+			(SpatialEdge){c->geom.y + c->geom.height, c->geom.x, c};
+		n++;
+	}
+
+	qsort(spatial_index.left, n, sizeof(SpatialEdge), spatial_edge_cmp);
+	qsort(spatial_index.right, n, sizeof(SpatialEdge), spatial_edge_cmp);
+	qsort(spatial_index.top, n, sizeof(SpatialEdge), spatial_edge_cmp);
+	qsort(spatial_index.bottom, n, sizeof(SpatialEdge), spatial_edge_cmp);
+
+	spatial_index.len = n;
+	spatial_index.serial = geometry_serial;
+}
+
+// 第一个不小于(key, key2)的位置
+unsigned int spatial_lower_bound(SpatialEdge *edges, int key, int key2) {
+	unsigned int lo = 0, hi = spatial_index.len, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (edges[mid].key < key ||
+			(edges[mid].key == key && edges[mid].key2 < key2))
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/* 在key落在[lo, hi]的窗口里找第一个满足match的,
+ * reverse为true时从hi往lo方向找 */
+Client *spatial_find_edge(int which, int lo, int hi, bool reverse, Client *c,
+						  bool (*match)(Client *tc, Client *c)) {
+	SpatialEdge *edges;
+	unsigned int begin, end, i;
+
+	if (lo > hi)
+		return NULL;
+
+	spatial_index_update();
+	edges = which == SpatialLeft	? spatial_index.left
+			: which == SpatialRight ? spatial_index.right
+			: which == SpatialTop	? spatial_index.top
+									: spatial_index.bottom;
+	begin = spatial_lower_bound(edges, lo, INT_MIN);
+	end = hi == INT_MAX ? spatial_index.len
+						: spatial_lower_bound(edges, hi + 1, INT_MIN);
+
+	for (i = 0; i < end - begin; i++) {
+		SpatialEdge *e = reverse ? &edges[end - 1 - i] : &edges[begin + i];
+		if (match(e->c, c))
+			return e->c;
+	}
+	return NULL;
+}
+
+// 跟c在水平方向上有重叠的当前显示器浮动窗口
+bool spatial_match_floating_overlap_x(Client *tc, Client *c) {
+	return tc != c && tc->isfloating && VISIBLEON(tc, selmon) &&
+		   c->geom.x + c->geom.width >= tc->geom.x &&
+		   c->geom.x <= tc->geom.x + tc->geom.width;
+}
+
+// 跟c在垂直方向上有重叠的当前显示器浮动窗口
+bool spatial_match_floating_overlap_y(Client *tc, Client *c) {
+	return tc != c && tc->isfloating && VISIBLEON(tc, selmon) &&
+		   c->geom.y + c->geom.height >= tc->geom.y &&
+		   c->geom.y <= tc->geom.y + tc->geom.height;
+}
+
+static bool spatial_direction_candidate(Client *c, bool findfloating) {
+	return (findfloating || !c->isfloating) && !c->isunglobal &&
+		   !c->iskilling && (focus_cross_monitor || c->mon == selmon) &&
+		   VISIBLEON(c, c->mon);
+}
+
+/* 找(x, y)在某个方向上最近的窗口.
+ * 先找同一条线上(UP/DOWN时x相同,LEFT/RIGHT时y相同)的,
+ * align为false时再按距离找该方向上最近的 */
+Client *spatial_find_direction(int x, int y, int dir, bool findfloating,
+							   bool align) {
+	SpatialEdge *edges, *e;
+	Client *best = NULL;
+	long long int distance = LLONG_MAX, tmp_distance, dx, dy, d;
+	unsigned int i, start;
+	bool backward;
+	int axis, cross;
+
+	spatial_index_update();
+
+	// 上下方向用x排序找同列,左右方向用y排序找同行
+	edges = dir == UP || dir == DOWN ? spatial_index.left : spatial_index.top;
+	axis = dir == UP || dir == DOWN ? x : y;
+	cross = dir == UP || dir == DOWN ? y : x;
+	backward = dir == UP || dir == LEFT;
+
+	if (backward) {
+		i = spatial_lower_bound(edges, axis, cross);
+		while (i-- > 0 && edges[i].key == axis) {
+			if (spatial_direction_candidate(edges[i].c, findfloating))
+				return edges[i].c;
+		}
+	} else {
+		for (i = spatial_lower_bound(edges, axis, cross + 1);
+			 i < spatial_index.len && edges[i].key == axis; i++) {
+			if (spatial_direction_candidate(edges[i].c, findfloating))
+				return edges[i].c;
+		}
+	}
+
+	if (align)
+		return NULL;
+
+	// 沿移动方向的轴排序,离得越远主轴距离越大,超过当前最近距离就停止
+	edges = dir == UP || dir == DOWN ? spatial_index.top : spatial_index.left;
+	start = backward ? spatial_lower_bound(edges, cross, INT_MIN)
+					 : spatial_lower_bound(edges, cross + 1, INT_MIN);
+
+	for (i = 0; backward ? i < start : start + i < spatial_index.len; i++) {
+		e = backward ? &edges[start - 1 - i] : &edges[start + i];
+		d = (long long int)e->key - cross;
+		if (d * d >= distance)
+			break;
+		if (!spatial_direction_candidate(e->c, findfloating))
+			continue;
+		dx = (long long int)e->c->geom.x - x;
+		dy = (long long int)e->c->geom.y - y;
+		tmp_distance = dx * dx + dy * dy;
+		if (tmp_distance < distance) {
+			distance = tmp_distance;
+			best = e->c;
+		}
+	}
+
+	return best;
+}
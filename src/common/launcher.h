@@ -0,0 +1,196 @@
+/*
+ * spawn用的启动器进程.setup里在创建wayland显示和渲染器之前fork出来,
+ * 那时候进程还很小,之后spawn只把命令行和当前的环境变量通过socketpair
+ * 发给它,由它去fork/exec,合成器自己不用再fork.
+ * 启动器fork之后把子进程pid发回来,用于统计启动耗时.
+ * 启动器不可用或者消息太大时spawn退回直接fork.
+ */
+#include <sys/socket.h>
+
+#define LAUNCHER_MSG_MAX 65536 /* 命令行加所有环境变量 */
+
+extern char **environ;
+
+static int launcher_fd = -1;
+static pid_t launcher_pid = -1;
+static struct wl_event_source *launcher_source;
+static char launcher_msg[LAUNCHER_MSG_MAX];
+
+// 在fork出来的子进程里调用,解析命令行并exec,不会返回
+void spawn_exec(char *cmd) {
+	// 1. 忽略可能导致 coredump 的信号
+	signal(SIGSEGV, SIG_IGN);
+	signal(SIGABRT, SIG_IGN);
+	signal(SIGILL, SIG_IGN);
+	signal(SIGCHLD, SIG_DFL);
+
+	dup2(STDERR_FILENO, STDOUT_FILENO);
+	setsid();
+
+	// 2. 解析参数
+	char *argv[64];
+	int argc = 0;
+	char *token = strtok(cmd, " ");
+	while (token != NULL && argc < 63) {
+		wordexp_t p;
+		if (wordexp(token, &p, 0) == 0) {
+			argv[argc++] = p.we_wordv[0];
+		} else {
+			argv[argc++] = token;
+		}
+		token = strtok(NULL, " ");
+	}
+	argv[argc] = NULL;
+
+	// 3. 执行命令
+	execvp(argv[0], argv);
+
+	// 4. execvp 失败时：打印错误并直接退出（避免 coredump）
+	wlr_log(WLR_ERROR, "dwl: execvp '%s' failed: %s\n", argv[0],
+			strerror(errno));
+	_exit(EXIT_FAILURE); // 使用 _exit 避免缓冲区刷新等操作
+}
+
+/* 启动器的主循环.每条消息是"命令\0环境变量1\0环境变量2\0...",
+ * socket另一头关闭(合成器退出)时结束 */
+static void launcher_run(int fd) {
+	char **env;
+	ssize_t n, i;
+	size_t count;
+	pid_t pid;
+
+	// 子进程由内核自动回收,exec前在spawn_exec里恢复
+	signal(SIGCHLD, SIG_IGN);
+	signal(SIGINT, SIG_DFL);
+	signal(SIGTERM, SIG_DFL);
+	signal(SIGPIPE, SIG_DFL);
+
+	for (;;) {
+		n = recv(fd, launcher_msg, sizeof(launcher_msg) - 1, 0);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+			_exit(0);
+		launcher_msg[n] = '\0';
+
+		// 失败时回复-1,保证回复和请求一一对应
+		if ((pid = fork()) != 0) {
+			send(fd, &pid, sizeof(pid), MSG_NOSIGNAL);
+			continue;
+		}
+
+		close(fd);
+		count = 0;
+		for (i = 0; i < n; i++)
+			count += launcher_msg[i] == '\0';
+		env = calloc(count + 1, sizeof(char *));
+		count = 0;
+		for (i = strlen(launcher_msg) + 1; env && i < n;
+			 i += strlen(launcher_msg + i) + 1)
+			env[count++] = launcher_msg + i;
+		if (env)
+			environ = env;
+		spawn_exec(launcher_msg);
+	}
+}
+
+// setup里尽早调用
+void launcher_start(void) {
+	int fds[2];
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) < 0) {
+		wlr_log_errno(WLR_ERROR, "launcher: socketpair");
+		return;
+	}
+
+	if ((launcher_pid = fork()) < 0) {
+		wlr_log_errno(WLR_ERROR, "launcher: fork");
+		close(fds[0]);
+		close(fds[1]);
+		return;
+	}
+	if (launcher_pid == 0) {
+		close(fds[0]);
+		launcher_run(fds[1]);
+	}
+
+	close(fds[1]);
+	launcher_fd = fds[0];
+}
+
+static void launcher_close(void) {
+	if (launcher_source) {
+		wl_event_source_remove(launcher_source);
+		launcher_source = NULL;
+	}
+	if (launcher_fd >= 0) {
+		close(launcher_fd);
+		launcher_fd = -1;
+	}
+	launch_stats_pid_lost();
+}
+
+static int launcher_readable(int fd, uint32_t mask, void *data) {
+	pid_t pid;
+	ssize_t n;
+
+	while ((n = recv(fd, &pid, sizeof(pid), MSG_DONTWAIT)) ==
+		   (ssize_t)sizeof(pid))
+		launch_stats_pid(pid);
+
+	if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) ||
+		(mask & (WL_EVENT_HANGUP | WL_EVENT_ERROR))) {
+		wlr_log(WLR_ERROR, "launcher: exited, falling back to fork");
+		launcher_close();
+	}
+	return 0;
+}
+
+// 把命令交给启动器,失败时返回false,由调用者自己fork
+bool launcher_spawn(const char *cmd) {
+	size_t len, size;
+	char **e;
+
+	if (launcher_fd < 0)
+		return false;
+
+	// 启动器在事件循环创建之前就启动了,第一次用的时候再监听回复
+	if (!launcher_source)
+		launcher_source = wl_event_loop_add_fd(
+			event_loop, launcher_fd, WL_EVENT_READABLE, launcher_readable, NULL);
+
+	size = strlen(cmd) + 1;
+	if (size > sizeof(launcher_msg))
+		return false;
+	memcpy(launcher_msg, cmd, size);
+	for (e = environ; *e; e++) {
+		len = strlen(*e) + 1;
+		if (size + len > sizeof(launcher_msg))
+			return false;
+		memcpy(launcher_msg + size, *e, len);
+		size += len;
+	}
+
+	/* 启动器卡住(被SIGSTOP,内存紧张时fork很慢)时socket可能写满,
+	 * 不能阻塞事件循环,这次退回直接fork,启动器先留着 */
+	if (send(launcher_fd, launcher_msg, size, MSG_NOSIGNAL | MSG_DONTWAIT) <
+		0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			wlr_log(WLR_DEBUG, "launcher: busy, falling back to fork");
+			return false;
+		}
+		wlr_log_errno(WLR_ERROR, "launcher: send, falling back to fork");
+		launcher_close();
+		return false;
+	}
+	return true;
+}
+
+// cleanup里调用,关掉socket后启动器自己退出
+void launcher_finish(void) {
+	launcher_close();
+	if (launcher_pid > 0) {
+		waitpid(launcher_pid, NULL, 0);
+		launcher_pid = -1;
+	}
+}
@@ -62,6 +62,7 @@ typedef struct {
 	int noswallow;
 	int scratchpad_width;
 	int scratchpad_height;
+	int max_frame_rate;
 	float focused_opacity;
 	float unfocused_opacity;
 	uint32_t passmod;
@@ -118,6 +119,16 @@ typedef struct {
 	Arg arg;
 } GestureBinding;
 
+/* 鼠标,滚轮和手势绑定在加载配置时编译成直接索引的表,事件来了不用再扫描.
+ * 修饰键去掉caps之后剩7位作为下标,表里存绑定的下标+1,0为没有绑定 */
+#define BINDING_MODS 128
+#define BINDING_MODS_INDEX(mask)                                               \
+	(((((mask) >> 1) & ~1u) | ((mask) & 1u)) & (BINDING_MODS - 1))
+#define MOUSE_BINDING_BUTTONS (BTN_TASK - BTN_LEFT + 1)
+#define AXIS_BINDING_DIRS 4
+#define GESTURE_BINDING_FINGERS 6
+#define GESTURE_BINDING_MOTIONS 4
+
 typedef struct {
 	int id;			   // 标签ID (1-9)
 	char *layout_name; // 布局名称
@@ -170,6 +181,7 @@ typedef struct {
 	int enable_floating_snap;
 	int drag_tile_to_tile;
 	unsigned int swipe_min_threshold;
+	unsigned int swipe_continuous_fingers;
 	float focused_opacity;
 	float unfocused_opacity;
 	float *scroller_proportion_preset;
@@ -189,6 +201,7 @@ typedef struct {
 	int overviewgappi;
 	int overviewgappo;
 	unsigned int cursor_hide_timeout;
+	unsigned int frame_stats_log_interval;
 
 	unsigned int axis_bind_apply_timeout;
 	unsigned int focus_on_activate;
@@ -276,6 +289,13 @@ typedef struct {
 	GestureBinding *gesture_bindings;
 	int gesture_bindings_count;
 
+	uint16_t mouse_binding_table[MOUSE_BINDING_BUTTONS][BINDING_MODS];
+	uint16_t axis_binding_table[AXIS_BINDING_DIRS][BINDING_MODS];
+	/* 同一个手势可以触发多个绑定,后面的通过gesture_binding_next串起来 */
+	uint16_t gesture_binding_table[GESTURE_BINDING_FINGERS]
+								  [GESTURE_BINDING_MOTIONS][BINDING_MODS];
+	uint16_t *gesture_binding_next;
+
 	char **exec;
 	int exec_count;
 
@@ -778,6 +798,22 @@ FuncType parse_func_name(char *func_name, Arg *arg, char *arg_value,
 		func = viewtoright_have_client;
 	} else if (strcmp(func_name, "reload_config") == 0) {
 		func = reload_config;
+	} else if (strcmp(func_name, "trace_start") == 0) {
+		func = trace_start;
+	} else if (strcmp(func_name, "trace_dump") == 0) {
+		func = trace_dump;
+		(*arg).v = strdup(arg_value);
+	} else if (strcmp(func_name, "input_record_start") == 0) {
+		func = input_record_start;
+		(*arg).v = strdup(arg_value);
+	} else if (strcmp(func_name, "input_record_stop") == 0) {
+		func = input_record_stop;
+	} else if (strcmp(func_name, "input_replay") == 0) {
+		func = input_replay;
+		(*arg).v = strdup(arg_value);
+	} else if (strcmp(func_name, "scroller_pan") == 0) {
+		func = scroller_pan;
+		(*arg).i = atoi(arg_value);
 	} else if (strcmp(func_name, "tag") == 0) {
 		func = tag;
 		(*arg).ui = 1 << (atoi(arg_value) - 1);
@@ -989,6 +1025,8 @@ void parse_config_line(Config *config, const char *line) {
 		config->drag_tile_to_tile = atoi(value);
 	} else if (strcmp(key, "swipe_min_threshold") == 0) {
 		config->swipe_min_threshold = atoi(value);
+	} else if (strcmp(key, "swipe_continuous_fingers") == 0) {
+		config->swipe_continuous_fingers = atoi(value);
 	} else if (strcmp(key, "focused_opacity") == 0) {
 		config->focused_opacity = atof(value);
 	} else if (strcmp(key, "unfocused_opacity") == 0) {
@@ -1154,6 +1192,8 @@ void parse_config_line(Config *config, const char *line) {
 		config->overviewgappo = atoi(value);
 	} else if (strcmp(key, "cursor_hide_timeout") == 0) {
 		config->cursor_hide_timeout = atoi(value);
+	} else if (strcmp(key, "frame_stats_log_interval") == 0) {
+		config->frame_stats_log_interval = atoi(value);
 	} else if (strcmp(key, "axis_bind_apply_timeout") == 0) {
 		config->axis_bind_apply_timeout = atoi(value);
 	} else if (strcmp(key, "focus_on_activate") == 0) {
@@ -1416,6 +1456,7 @@ void parse_config_line(Config *config, const char *line) {
 		rule->isoverlay = -1;
 		rule->isterm = -1;
 		rule->noswallow = -1;
+		rule->max_frame_rate = -1;
 		rule->monitor = -1;
 		rule->offsetx = 0;
 		rule->offsety = 0;
@@ -1499,6 +1540,8 @@ void parse_config_line(Config *config, const char *line) {
 					rule->isterm = atoi(val);
 				} else if (strcmp(key, "noswallow") == 0) {
 					rule->noswallow = atoi(val);
+				} else if (strcmp(key, "max_frame_rate") == 0) {
+					rule->max_frame_rate = atoi(val);
 				} else if (strcmp(key, "scroller_proportion") == 0) {
 					rule->scroller_proportion = atof(val);
 				} else if (strcmp(key, "isfullscreen") == 0) {
@@ -1949,6 +1992,9 @@ void free_config(void) {
 	// 释放内存
 	int i;
 
+	// 按住重复的快捷键和正在执行的手势绑定靠它发现配置已经被释放
+	bindings_serial++;
+
 	// 释放 window_rules
 	if (config.window_rules) {
 		for (int i = 0; i < config.window_rules_count; i++) {
@@ -2062,6 +2108,8 @@ void free_config(void) {
 		config.gesture_bindings = NULL;
 		config.gesture_bindings_count = 0;
 	}
+	free(config.gesture_binding_next);
+	config.gesture_binding_next = NULL;
 
 	// 释放 tag_rules
 	if (config.tag_rules) {
@@ -2205,6 +2253,8 @@ void override_config(void) {
 	no_radius_when_single = CLAMP_INT(config.no_radius_when_single, 0, 1);
 	cursor_hide_timeout =
 		CLAMP_INT(config.cursor_hide_timeout, 0, 36000); // 0-10小时
+	frame_stats_log_interval =
+		CLAMP_INT(config.frame_stats_log_interval, 0, 86400);
 	drag_tile_to_tile = CLAMP_INT(config.drag_tile_to_tile, 0, 1);
 	single_scratchpad = CLAMP_INT(config.single_scratchpad, 0, 1);
 
@@ -2224,6 +2274,7 @@ void override_config(void) {
 	left_handed = CLAMP_INT(config.left_handed, 0, 1);
 	middle_button_emulation = CLAMP_INT(config.middle_button_emulation, 0, 1);
 	swipe_min_threshold = CLAMP_INT(config.swipe_min_threshold, 1, 1000);
+	swipe_continuous_fingers = CLAMP_INT(config.swipe_continuous_fingers, 0, 5);
 
 	// 鼠标设置
 	mouse_natural_scrolling = CLAMP_INT(config.mouse_natural_scrolling, 0, 1);
@@ -2354,6 +2405,7 @@ void set_value_default() {
 	config.drag_tile_to_tile = drag_tile_to_tile;
 	config.enable_floating_snap = enable_floating_snap;
 	config.swipe_min_threshold = swipe_min_threshold;
+	config.swipe_continuous_fingers = swipe_continuous_fingers;
 
 	config.inhibit_regardless_of_visibility =
 		inhibit_regardless_of_visibility; /* 1 means idle inhibitors will
@@ -2365,6 +2417,7 @@ void set_value_default() {
 	config.overviewgappi = overviewgappi; /* overview时 窗口与边缘 缝隙大小 */
 	config.overviewgappo = overviewgappo; /* overview时 窗口与窗口 缝隙大小 */
 	config.cursor_hide_timeout = cursor_hide_timeout;
+	config.frame_stats_log_interval = frame_stats_log_interval;
 
 	config.warpcursor = warpcursor; /* Warp cursor to focused client */
 
@@ -2455,7 +2508,53 @@ void set_default_key_bindings(Config *config) {
 	config->key_bindings_count += default_key_bindings_count;
 }
 
+// 同一个表项有多个绑定时,鼠标和滚轮只有第一个会生效,和原来扫描时一致
+void compile_binding_tables(void) {
+	const MouseBinding *b;
+	const AxisBinding *a;
+	const GestureBinding *g;
+	uint16_t *slot;
+	int i;
+
+	for (i = 0; i < config.mouse_bindings_count; i++) {
+		b = &config.mouse_bindings[i];
+		if (!b->func || b->button < BTN_LEFT || b->button > BTN_TASK)
+			continue;
+		slot = &config.mouse_binding_table[b->button - BTN_LEFT]
+										  [BINDING_MODS_INDEX(b->mod)];
+		if (!*slot)
+			*slot = i + 1;
+	}
+
+	for (i = 0; i < config.axis_bindings_count; i++) {
+		a = &config.axis_bindings[i];
+		if (!a->func || a->dir >= AXIS_BINDING_DIRS)
+			continue;
+		slot = &config.axis_binding_table[a->dir][BINDING_MODS_INDEX(a->mod)];
+		if (!*slot)
+			*slot = i + 1;
+	}
+
+	if (config.gesture_bindings_count > 0)
+		config.gesture_binding_next =
+			calloc(config.gesture_bindings_count, sizeof(uint16_t));
+	if (!config.gesture_binding_next)
+		return;
+	// 倒着插到链表头,链表里保持配置文件里的顺序
+	for (i = config.gesture_bindings_count - 1; i >= 0; i--) {
+		g = &config.gesture_bindings[i];
+		if (!g->func || g->fingers_count >= GESTURE_BINDING_FINGERS ||
+			g->motion >= GESTURE_BINDING_MOTIONS)
+			continue;
+		slot = &config.gesture_binding_table[g->fingers_count][g->motion]
+											[BINDING_MODS_INDEX(g->mod)];
+		config.gesture_binding_next[i] = *slot;
+		*slot = i + 1;
+	}
+}
+
 void parse_config(void) {
+	TRACE_SCOPE("parse_config");
 
 	char filename[1024];
 
@@ -2519,6 +2618,7 @@ void parse_config(void) {
 	parse_config_file(&config, filename);
 	set_default_key_bindings(&config);
 	override_config();
+	compile_binding_tables();
 }
 
 void reset_blur_params(void) {
@@ -2559,6 +2659,7 @@ void reload_config(const Arg *arg) {
 	handlecursoractivity();
 	reset_keyboard_layout();
 	reset_blur_params();
+	frame_stats_schedule_log();
 	run_exec();
 
 	// reset border width when config change
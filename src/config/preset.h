@@ -68,8 +68,10 @@ int enable_floating_snap = 0;
 int drag_tile_to_tile = 0;
 unsigned int cursor_size = 24;
 unsigned int cursor_hide_timeout = 0;
+unsigned int frame_stats_log_interval = 0; /* 秒,0为不打印帧耗时统计 */
 
 unsigned int swipe_min_threshold = 20;
+unsigned int swipe_continuous_fingers = 0; /* 0为关闭,见animation/swipe.h */
 
 int inhibit_regardless_of_visibility =
 	0; /* 1 means idle inhibitors will disable idle tracking even if it's
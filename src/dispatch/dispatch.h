@@ -36,6 +36,12 @@ void focusmon(const Arg *arg);
 void focusstack(const Arg *arg);
 void chvt(const Arg *arg);
 void reload_config(const Arg *arg);
+void trace_start(const Arg *arg);
+void trace_dump(const Arg *arg);
+void input_record_start(const Arg *arg);
+void input_record_stop(const Arg *arg);
+void input_replay(const Arg *arg);
+void scroller_pan(const Arg *arg);
 void smartmovewin(const Arg *arg);
 void smartresizewin(const Arg *arg);
 void bind_to_view(const Arg *arg);
@@ -84,6 +84,8 @@ void dwl_ipc_manager_get_output(struct wl_client *client,
 	ipc_output = ecalloc(1, sizeof(*ipc_output));
 	ipc_output->resource = output_resource;
 	ipc_output->mon = monitor;
+	ipc_output->tag_states =
+		ecalloc(LENGTH(tags), sizeof(*ipc_output->tag_states));
 	wl_resource_set_implementation(output_resource, &dwl_output_implementation,
 								   ipc_output, dwl_ipc_output_destroy);
 	wl_list_insert(&monitor->dwl_ipc_outputs, &ipc_output->link);
@@ -98,6 +100,11 @@ void dwl_ipc_manager_release(struct wl_client *client,
 static void dwl_ipc_output_destroy(struct wl_resource *resource) {
 	DwlIpcOutput *ipc_output = wl_resource_get_user_data(resource);
 	wl_list_remove(&ipc_output->link);
+	free(ipc_output->tag_states);
+	free(ipc_output->title);
+	free(ipc_output->appid);
+	free(ipc_output->symbol);
+	free(ipc_output->last_layer);
 	free(ipc_output);
 }
 
@@ -107,80 +114,138 @@ void dwl_ipc_output_printstatus(Monitor *monitor) {
 		dwl_ipc_output_printstatus_to(ipc_output);
 }
 
+/* 跟上一次发给这个resource的值比较,第一次发送或者有变化时记录并返回true */
+static bool dwl_ipc_output_int_changed(DwlIpcOutput *ipc_output, int *last,
+									   int value) {
+	if (ipc_output->sent && *last == value)
+		return false;
+	*last = value;
+	return true;
+}
+
+static bool dwl_ipc_output_str_changed(DwlIpcOutput *ipc_output, char **last,
+									   const char *value) {
+	if (ipc_output->sent && *last && strcmp(*last, value) == 0)
+		return false;
+	free(*last);
+	*last = strdup(value);
+	return true;
+}
+
 void dwl_ipc_output_printstatus_to(DwlIpcOutput *ipc_output) {
 	Monitor *monitor = ipc_output->mon;
-	Client *c, *focused;
-	int tagmask, state, numclients, focused_client, tag;
+	struct wl_resource *resource = ipc_output->resource;
+	unsigned int version = wl_resource_get_version(resource);
+	DwlIpcTagState *last;
+	Client *focused;
+	unsigned int state, focused_client;
+	int tagmask, tag;
 	const char *title, *appid, *symbol;
+	bool changed = false;
+
 	focused = focustop(monitor);
-	zdwl_ipc_output_v2_send_active(ipc_output->resource, monitor == selmon);
 
+	if (dwl_ipc_output_int_changed(ipc_output, &ipc_output->active,
+								   monitor == selmon)) {
+		zdwl_ipc_output_v2_send_active(resource, ipc_output->active);
+		changed = true;
+	}
+
+	// 每个标签的窗口数和紧急窗口数在标签索引里增量维护
 	for (tag = 0; tag < LENGTH(tags); tag++) {
-		numclients = state = focused_client = 0;
 		tagmask = 1 << tag;
+		state = 0;
 		if ((tagmask & monitor->tagset[monitor->seltags]) != 0)
 			state |= ZDWL_IPC_OUTPUT_V2_TAG_STATE_ACTIVE;
-		wl_list_for_each(c, &clients, link) {
-			if (c->mon != monitor)
-				continue;
-			if (!(c->tags & tagmask))
-				continue;
-			if (c == focused)
-				focused_client = 1;
-			if (c->isurgent)
-				state |= ZDWL_IPC_OUTPUT_V2_TAG_STATE_URGENT;
-			numclients++;
-		}
-		zdwl_ipc_output_v2_send_tag(ipc_output->resource, tag, state,
-									numclients, focused_client);
+		if (monitor->pertag->nurgent[tag])
+			state |= ZDWL_IPC_OUTPUT_V2_TAG_STATE_URGENT;
+		focused_client = focused && (focused->tags & tagmask) ? 1 : 0;
+
+		last = &ipc_output->tag_states[tag];
+		if (ipc_output->sent && last->state == state &&
+			last->clients == monitor->pertag->nclients[tag] &&
+			last->focused == focused_client)
+			continue;
+
+		last->state = state;
+		last->clients = monitor->pertag->nclients[tag];
+		last->focused = focused_client;
+		zdwl_ipc_output_v2_send_tag(resource, tag, last->state, last->clients,
+									last->focused);
+		changed = true;
 	}
 
 	title = focused ? client_get_title(focused) : "";
 	appid = focused ? client_get_appid(focused) : "";
 	symbol = monitor->pertag->ltidxs[monitor->pertag->curtag]->symbol;
 
-	zdwl_ipc_output_v2_send_layout(
-		ipc_output->resource,
-		monitor->pertag->ltidxs[monitor->pertag->curtag] - layouts);
-	zdwl_ipc_output_v2_send_title(ipc_output->resource, title ? title : broken);
-	zdwl_ipc_output_v2_send_appid(ipc_output->resource, appid ? appid : broken);
-	zdwl_ipc_output_v2_send_layout_symbol(ipc_output->resource, symbol);
-	if (wl_resource_get_version(ipc_output->resource) >=
-		ZDWL_IPC_OUTPUT_V2_FULLSCREEN_SINCE_VERSION) {
-		zdwl_ipc_output_v2_send_fullscreen(ipc_output->resource,
-										   focused ? focused->isfullscreen : 0);
+	if (dwl_ipc_output_int_changed(
+			ipc_output, &ipc_output->layout,
+			monitor->pertag->ltidxs[monitor->pertag->curtag] - layouts)) {
+		zdwl_ipc_output_v2_send_layout(resource, ipc_output->layout);
+		changed = true;
+	}
+	if (dwl_ipc_output_str_changed(ipc_output, &ipc_output->title,
+								   title ? title : broken)) {
+		zdwl_ipc_output_v2_send_title(resource, ipc_output->title);
+		changed = true;
+	}
+	if (dwl_ipc_output_str_changed(ipc_output, &ipc_output->appid,
+								   appid ? appid : broken)) {
+		zdwl_ipc_output_v2_send_appid(resource, ipc_output->appid);
+		changed = true;
 	}
-	if (wl_resource_get_version(ipc_output->resource) >=
-		ZDWL_IPC_OUTPUT_V2_FLOATING_SINCE_VERSION) {
-		zdwl_ipc_output_v2_send_floating(ipc_output->resource,
-										 focused ? focused->isfloating : 0);
+	if (dwl_ipc_output_str_changed(ipc_output, &ipc_output->symbol, symbol)) {
+		zdwl_ipc_output_v2_send_layout_symbol(resource, ipc_output->symbol);
+		changed = true;
 	}
-	if (wl_resource_get_version(ipc_output->resource) >=
-		ZDWL_IPC_OUTPUT_V2_X_SINCE_VERSION) {
-		zdwl_ipc_output_v2_send_x(ipc_output->resource,
-								  focused ? focused->geom.x : 0);
+	if (version >= ZDWL_IPC_OUTPUT_V2_FULLSCREEN_SINCE_VERSION &&
+		dwl_ipc_output_int_changed(ipc_output, &ipc_output->fullscreen,
+								   focused ? focused->isfullscreen : 0)) {
+		zdwl_ipc_output_v2_send_fullscreen(resource, ipc_output->fullscreen);
+		changed = true;
 	}
-	if (wl_resource_get_version(ipc_output->resource) >=
-		ZDWL_IPC_OUTPUT_V2_Y_SINCE_VERSION) {
-		zdwl_ipc_output_v2_send_y(ipc_output->resource,
-								  focused ? focused->geom.y : 0);
+	if (version >= ZDWL_IPC_OUTPUT_V2_FLOATING_SINCE_VERSION &&
+		dwl_ipc_output_int_changed(ipc_output, &ipc_output->floating,
+								   focused ? focused->isfloating : 0)) {
+		zdwl_ipc_output_v2_send_floating(resource, ipc_output->floating);
+		changed = true;
 	}
-	if (wl_resource_get_version(ipc_output->resource) >=
-		ZDWL_IPC_OUTPUT_V2_WIDTH_SINCE_VERSION) {
-		zdwl_ipc_output_v2_send_width(ipc_output->resource,
-									  focused ? focused->geom.width : 0);
+	if (version >= ZDWL_IPC_OUTPUT_V2_X_SINCE_VERSION &&
+		dwl_ipc_output_int_changed(ipc_output, &ipc_output->x,
+								   focused ? focused->geom.x : 0)) {
+		zdwl_ipc_output_v2_send_x(resource, ipc_output->x);
+		changed = true;
 	}
-	if (wl_resource_get_version(ipc_output->resource) >=
-		ZDWL_IPC_OUTPUT_V2_HEIGHT_SINCE_VERSION) {
-		zdwl_ipc_output_v2_send_height(ipc_output->resource,
-									   focused ? focused->geom.height : 0);
+	if (version >= ZDWL_IPC_OUTPUT_V2_Y_SINCE_VERSION &&
+		dwl_ipc_output_int_changed(ipc_output, &ipc_output->y,
+								   focused ? focused->geom.y : 0)) {
+		zdwl_ipc_output_v2_send_y(resource, ipc_output->y);
+		changed = true;
 	}
-	if (wl_resource_get_version(ipc_output->resource) >=
-		ZDWL_IPC_OUTPUT_V2_LAST_LAYER_SINCE_VERSION) {
-		zdwl_ipc_output_v2_send_last_layer(ipc_output->resource,
-										   monitor->last_surface_ws_name);
+	if (version >= ZDWL_IPC_OUTPUT_V2_WIDTH_SINCE_VERSION &&
+		dwl_ipc_output_int_changed(ipc_output, &ipc_output->width,
+								   focused ? focused->geom.width : 0)) {
+		zdwl_ipc_output_v2_send_width(resource, ipc_output->width);
+		changed = true;
 	}
-	zdwl_ipc_output_v2_send_frame(ipc_output->resource);
+	if (version >= ZDWL_IPC_OUTPUT_V2_HEIGHT_SINCE_VERSION &&
+		dwl_ipc_output_int_changed(ipc_output, &ipc_output->height,
+								   focused ? focused->geom.height : 0)) {
+		zdwl_ipc_output_v2_send_height(resource, ipc_output->height);
+		changed = true;
+	}
+	if (version >= ZDWL_IPC_OUTPUT_V2_LAST_LAYER_SINCE_VERSION &&
+		dwl_ipc_output_str_changed(ipc_output, &ipc_output->last_layer,
+								   monitor->last_surface_ws_name)) {
+		zdwl_ipc_output_v2_send_last_layer(resource, ipc_output->last_layer);
+		changed = true;
+	}
+
+	// 什么都没变就不发frame,避免bar无意义地重绘
+	if (changed)
+		zdwl_ipc_output_v2_send_frame(resource);
+	ipc_output->sent = true;
 }
 
 void dwl_ipc_output_set_client_tags(struct wl_client *client,
@@ -206,6 +271,7 @@ void dwl_ipc_output_set_client_tags(struct wl_client *client,
 		return;
 
 	selected_client->tags = newtags;
+	client_update_tagindex(selected_client);
 	if (selmon == monitor)
 		focusclient(focustop(monitor), 1);
 	arrange(selmon, false);
@@ -0,0 +1,774 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/*
+ * unix socket ipc,路径导出在$MAOMAO_SOCKET里.
+ * 每行一条命令:
+ *   subscribe <focus|tags|clients|layout|outputs|all>...
+ *   unsubscribe <focus|tags|clients|layout|outputs|all>...
+ *   get <focus|tags|clients|layout|outputs|frames|commits|launches|all>...
+ *     (frames是每个显示器的帧耗时统计,commits是每个窗口的提交统计,
+ *      launches是最近几次spawn的启动耗时,这三类只能get不能订阅)
+ *   dispatch <func> [arg1] [arg2] [arg3] [arg4] [arg5]
+ *   batch <func> [args]... ; <func> [args]... ; ...
+ *     (按顺序执行,中间不arrange,最后每个显示器只arrange一次)
+ *   state
+ *     (回复里带两个fd:共享内存状态块的只读fd和一个eventfd,见state.h)
+ * 事件和回复都是一行一个json对象,get先返回对应的事件再返回结果.
+ *
+ * 写都是非阻塞的,每个连接有自己的环形缓冲区.
+ * 读得慢的连接缓冲区满了之后事件不再排队,只记录哪一类被丢了,
+ * 等缓冲区空出来再补发这一类的最新状态,所以永远不会阻塞合成器.
+ */
+
+enum {
+	IpcEventFocus,
+	IpcEventTags,
+	IpcEventClients,
+	IpcEventLayout,
+	IpcEventOutputs,
+	IpcEventFrames,
+	IpcEventCommits,
+	IpcEventLaunches,
+	IPC_EVENT_COUNT
+};
+
+#define IPC_EVENT_ALL ((1u << IPC_EVENT_COUNT) - 1)
+/* 每帧都在变,不广播 */
+#define IPC_EVENT_GET_ONLY                                                     \
+	((1u << IpcEventFrames) | (1u << IpcEventCommits) |                        \
+	 (1u << IpcEventLaunches))
+#define IPC_BUFFER_SIZE 65536	 /* 事件最多能占用的缓冲区 */
+#define IPC_BUFFER_MAX (1 << 22) /* 命令回复不丢,缓冲区最多扩到这么大 */
+#define IPC_LINE_MAX 4096
+
+static const char *ipc_event_names[IPC_EVENT_COUNT] = {
+	"focus",   "tags",   "clients", "layout",
+	"outputs", "frames", "commits", "launches",
+};
+
+typedef struct {
+	char *data;
+	size_t len, cap;
+} IpcBuf;
+
+typedef struct {
+	struct wl_list link;
+	int fd;
+	struct wl_event_source *source;
+	unsigned int subscriptions;
+	unsigned int dropped; /* 缓冲区满时被丢掉的事件类 */
+	char *ring;
+	size_t ring_cap, ring_head, ring_len;
+	char in[IPC_LINE_MAX];
+	size_t in_len;
+	int state_eventfd; /* 共享内存状态更新时通知,-1为没有 */
+	bool send_state_fds; /* 下一次发送时附带状态块的fd */
+} IpcClient;
+
+static struct {
+	int fd;
+	char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+	struct wl_event_source *source;
+	struct wl_list clients;
+	unsigned int next_client_id;
+	char *last[IPC_EVENT_COUNT]; /* 上一次广播的内容,没变就不发 */
+} ipc_server = {.fd = -1};
+
+static void ipc_buf_reserve(IpcBuf *buf, size_t n) {
+	if (buf->len + n <= buf->cap)
+		return;
+	buf->cap = MAX(buf->cap * 2, buf->len + n);
+	if (!(buf->data = realloc(buf->data, buf->cap)))
+		die("realloc:");
+}
+
+static void ipc_buf_printf(IpcBuf *buf, const char *fmt, ...) {
+	va_list ap;
+	int n;
+
+	va_start(ap, fmt);
+	n = vsnprintf(NULL, 0, fmt, ap);
+	va_end(ap);
+	if (n < 0)
+		return;
+
+	ipc_buf_reserve(buf, n + 1);
+	va_start(ap, fmt);
+	vsnprintf(buf->data + buf->len, n + 1, fmt, ap);
+	va_end(ap);
+	buf->len += n;
+}
+
+// 带引号和转义的json字符串
+static void ipc_buf_str(IpcBuf *buf, const char *s) {
+	ipc_buf_printf(buf, "\"");
+	for (s = s ? s : ""; *s; s++) {
+		if (*s == '"' || *s == '\\') {
+			ipc_buf_printf(buf, "\\%c", *s);
+		} else if ((unsigned char)*s < 0x20) {
+			ipc_buf_printf(buf, "\\u%04x", (unsigned char)*s);
+		} else {
+			ipc_buf_reserve(buf, 1);
+			buf->data[buf->len++] = *s;
+		}
+	}
+	// printf会补上结尾的'\0'
+	ipc_buf_printf(buf, "\"");
+}
+
+static unsigned int ipc_client_id(Client *c) {
+	if (!c->ipc_id)
+		c->ipc_id = ++ipc_server.next_client_id;
+	return c->ipc_id;
+}
+
+static void ipc_serialize_client(IpcBuf *buf, Client *c) {
+	ipc_buf_printf(buf, "{\"id\":%u,\"appid\":", ipc_client_id(c));
+	ipc_buf_str(buf, client_get_appid(c));
+	ipc_buf_printf(buf, ",\"title\":");
+	ipc_buf_str(buf, client_get_title(c));
+	ipc_buf_printf(buf, ",\"output\":");
+	ipc_buf_str(buf, c->mon ? c->mon->wlr_output->name : "");
+	ipc_buf_printf(buf,
+				   ",\"tags\":%u,\"floating\":%s,\"fullscreen\":%s,"
+				   "\"minimized\":%s,\"urgent\":%s}",
+				   c->tags, c->isfloating ? "true" : "false",
+				   c->isfullscreen ? "true" : "false",
+				   c->isminied ? "true" : "false",
+				   c->isurgent ? "true" : "false");
+}
+
+static void ipc_serialize_frame_stat(IpcBuf *buf, const char *name,
+									 FrameStat *s) {
+	unsigned int i;
+
+	ipc_buf_printf(buf,
+				   ",\"%s\":{\"count\":%llu,\"last_us\":%.1f,\"avg_us\":%.1f,"
+				   "\"min_us\":%.1f,\"max_us\":%.1f,\"histogram\":[",
+				   name, (unsigned long long)s->count, s->last_ns / 1e3,
+				   s->avg_ns / 1e3, s->min_ns / 1e3, s->max_ns / 1e3);
+	for (i = 0; i < FRAME_HIST_BUCKETS; i++)
+		ipc_buf_printf(buf, i ? ",%u" : "%u", s->hist[i]);
+	ipc_buf_printf(buf, "]}");
+}
+
+// 两个时间点之间的毫秒数,有一个还没发生就是null
+static void ipc_serialize_span(IpcBuf *buf, const char *name, uint64_t from,
+							   uint64_t to) {
+	if (from && to && to >= from)
+		ipc_buf_printf(buf, ",\"%s\":%.3f", name, (to - from) / 1e6);
+	else
+		ipc_buf_printf(buf, ",\"%s\":null", name);
+}
+
+static void ipc_serialize_launch(IpcBuf *buf, LaunchRecord *r) {
+	ipc_buf_printf(buf, "{\"cmd\":");
+	ipc_buf_str(buf, r->cmd);
+	ipc_buf_printf(buf, ",\"pid\":%d,\"appid\":", (int)r->pid);
+	ipc_buf_str(buf, r->appid);
+	if (r->c)
+		ipc_buf_printf(buf, ",\"client\":%u", ipc_client_id(r->c));
+	else
+		ipc_buf_printf(buf, ",\"client\":null");
+	ipc_serialize_span(buf, "spawn_to_commit_ms", r->spawn_ns, r->commit_ns);
+	ipc_serialize_span(buf, "commit_to_map_ms", r->commit_ns, r->map_start_ns);
+	ipc_serialize_span(buf, "map_ms", r->map_start_ns, r->map_done_ns);
+	ipc_serialize_span(buf, "map_to_present_ms", r->map_done_ns,
+					   r->present_ns);
+	ipc_serialize_span(buf, "open_animation_ms", r->map_done_ns,
+					   r->animation_done_ns);
+	ipc_serialize_span(buf, "total_ms", r->spawn_ns, r->present_ns);
+	ipc_buf_printf(buf, "}");
+}
+
+// 生成某一类事件的当前状态,不带换行
+static void ipc_serialize(IpcBuf *buf, int event) {
+	Client *c;
+	Monitor *m;
+	ClientCommitStats *cs;
+	bool first = true;
+	unsigned int i, urgent;
+
+	ipc_buf_printf(buf, "{\"event\":\"%s\"", ipc_event_names[event]);
+
+	switch (event) {
+	case IpcEventFocus:
+		c = selmon ? focustop(selmon) : NULL;
+		ipc_buf_printf(buf, ",\"output\":");
+		ipc_buf_str(buf, selmon ? selmon->wlr_output->name : "");
+		ipc_buf_printf(buf, ",\"client\":");
+		if (c)
+			ipc_serialize_client(buf, c);
+		else
+			ipc_buf_printf(buf, "null");
+		break;
+	case IpcEventClients:
+		ipc_buf_printf(buf, ",\"clients\":[");
+		wl_list_for_each(c, &clients, link) {
+			if (c->iskilling || client_is_unmanaged(c))
+				continue;
+			ipc_buf_printf(buf, first ? "" : ",");
+			ipc_serialize_client(buf, c);
+			first = false;
+		}
+		ipc_buf_printf(buf, "]");
+		break;
+	case IpcEventCommits:
+		ipc_buf_printf(buf, ",\"clients\":[");
+		wl_list_for_each(c, &clients, link) {
+			cs = &c->cold->commit_stats;
+			ipc_buf_printf(buf, "%s{\"id\":%u,\"appid\":", first ? "" : ",",
+						   ipc_client_id(c));
+			ipc_buf_str(buf, client_get_appid(c));
+			ipc_buf_printf(
+				buf,
+				",\"visible\":%s,\"commits\":%llu,\"commit_rate\":%.1f,"
+				"\"damage_rate\":%.0f,\"damage_area\":%llu,"
+				"\"buffer_width\":%d,\"buffer_height\":%d,"
+				"\"configure_latency_us\":%.1f,"
+				"\"configure_latency_avg_us\":%.1f,\"max_frame_rate\":%d}",
+				c->mon && VISIBLEON(c, c->mon) ? "true" : "false",
+				(unsigned long long)cs->commits, client_stats_commit_rate(c),
+				cs->damage_rate, (unsigned long long)cs->damage_area,
+				cs->buffer_width, cs->buffer_height,
+				cs->configure_latency_ns / 1e3,
+				cs->configure_latency_avg_ns / 1e3, c->max_frame_rate);
+			first = false;
+		}
+		ipc_buf_printf(buf, "]");
+		break;
+	case IpcEventLaunches:
+		ipc_buf_printf(buf, ",\"launches\":[");
+		i = launch_stats.count > LAUNCH_RECORDS
+				? launch_stats.count - LAUNCH_RECORDS
+				: 0;
+		for (; i < launch_stats.count; i++) {
+			ipc_buf_printf(buf, first ? "" : ",");
+			ipc_serialize_launch(
+				buf, &launch_stats.records[i % LAUNCH_RECORDS]);
+			first = false;
+		}
+		ipc_buf_printf(buf, "]");
+		break;
+	case IpcEventTags:
+	case IpcEventLayout:
+	case IpcEventOutputs:
+	case IpcEventFrames:
+		ipc_buf_printf(buf, ",\"outputs\":[");
+		wl_list_for_each(m, &mons, link) {
+			if (event != IpcEventOutputs && !m->wlr_output->enabled)
+				continue;
+			ipc_buf_printf(buf, first ? "{\"name\":" : ",{\"name\":");
+			ipc_buf_str(buf, m->wlr_output->name);
+			first = false;
+
+			if (event == IpcEventFrames) {
+				ipc_buf_printf(buf,
+							   ",\"frames\":%llu,\"missed\":%llu,"
+							   "\"histogram_base_us\":64",
+							   (unsigned long long)m->frame_stats.frames,
+							   (unsigned long long)m->frame_stats.missed);
+				ipc_serialize_frame_stat(buf, "animate",
+										 &m->frame_stats.animate);
+				ipc_serialize_frame_stat(buf, "commit",
+										 &m->frame_stats.commit);
+				ipc_serialize_frame_stat(buf, "frame_to_commit",
+										 &m->frame_stats.frame_to_commit);
+				ipc_serialize_frame_stat(buf, "present_interval",
+										 &m->frame_stats.present_interval);
+				ipc_buf_printf(buf, "}");
+				continue;
+			}
+
+			if (event == IpcEventOutputs) {
+				ipc_buf_printf(
+					buf,
+					",\"enabled\":%s,\"focused\":%s,\"x\":%d,\"y\":%d,"
+					"\"width\":%d,\"height\":%d,\"scale\":%.2f}",
+					m->wlr_output->enabled ? "true" : "false",
+					m == selmon ? "true" : "false", m->m.x, m->m.y,
+					m->m.width, m->m.height, m->wlr_output->scale);
+				continue;
+			}
+
+			if (event == IpcEventLayout) {
+				ipc_buf_printf(buf, ",\"symbol\":");
+				ipc_buf_str(
+					buf, m->pertag->ltidxs[m->pertag->curtag]->symbol);
+				ipc_buf_printf(buf, ",\"index\":%d,\"overview\":%s}",
+							   (int)(m->pertag->ltidxs[m->pertag->curtag] -
+									 layouts),
+							   m->isoverview ? "true" : "false");
+				continue;
+			}
+
+			urgent = 0;
+			ipc_buf_printf(buf, ",\"active\":%u,\"clients\":[",
+						   m->tagset[m->seltags]);
+			for (i = 0; i < LENGTH(tags); i++) {
+				ipc_buf_printf(buf, i ? ",%u" : "%u", m->pertag->nclients[i]);
+				if (m->pertag->nurgent[i])
+					urgent |= 1 << i;
+			}
+			ipc_buf_printf(buf, "],\"urgent\":%u}", urgent);
+		}
+		ipc_buf_printf(buf, "]");
+		break;
+	}
+
+	ipc_buf_printf(buf, "}");
+}
+
+static void ipc_client_destroy(IpcClient *client) {
+	wl_list_remove(&client->link);
+	wl_event_source_remove(client->source);
+	close(client->fd);
+	if (client->state_eventfd >= 0)
+		close(client->state_eventfd);
+	free(client->ring);
+	free(client);
+}
+
+/* 放进环形缓冲区,整行要么全部放进去要么不放.
+ * 事件最多占IPC_BUFFER_SIZE,命令回复force为true,可以扩容.
+ * 缓冲区空的时候事件也可以扩容,不然超过IPC_BUFFER_SIZE的事件
+ * (窗口很多时的clients)永远发不出去 */
+static bool ipc_client_queue(IpcClient *client, const char *data, size_t len,
+							 bool force) {
+	size_t cap, tail, first;
+	char *ring;
+
+	if (client->ring_len + len >
+		(force || !client->ring_len ? IPC_BUFFER_MAX : IPC_BUFFER_SIZE))
+		return false;
+
+	if (client->ring_len + len > client->ring_cap) {
+		cap = MAX(MAX(client->ring_cap * 2, client->ring_len + len), 4096);
+		ring = ecalloc(1, cap);
+		// 扩容时顺便把内容排成连续的
+		first = MIN(client->ring_len, client->ring_cap - client->ring_head);
+		if (client->ring_len) {
+			memcpy(ring, client->ring + client->ring_head, first);
+			memcpy(ring + first, client->ring, client->ring_len - first);
+		}
+		free(client->ring);
+		client->ring = ring;
+		client->ring_cap = cap;
+		client->ring_head = 0;
+	}
+
+	tail = (client->ring_head + client->ring_len) % client->ring_cap;
+	first = MIN(len, client->ring_cap - tail);
+	memcpy(client->ring + tail, data, first);
+	memcpy(client->ring, data + first, len - first);
+	client->ring_len += len;
+	return true;
+}
+
+static void ipc_client_queue_event(IpcClient *client, int event, bool force) {
+	IpcBuf buf = {0};
+
+	ipc_serialize(&buf, event);
+	ipc_buf_printf(&buf, "\n");
+	if (ipc_client_queue(client, buf.data, buf.len, force))
+		client->dropped &= ~(1u << event);
+	else
+		client->dropped |= 1u << event;
+	free(buf.data);
+}
+
+// 发送一段数据,需要的话通过SCM_RIGHTS附带状态块的fd
+static ssize_t ipc_client_send(IpcClient *client, const char *data,
+							   size_t len) {
+	int fds[2] = {state_reader_fd(), client->state_eventfd};
+	union {
+		char buf[CMSG_SPACE(sizeof(fds))];
+		struct cmsghdr align;
+	} control = {0};
+	struct iovec iov = {.iov_base = (void *)data, .iov_len = len};
+	struct msghdr msg = {.msg_iov = &iov, .msg_iovlen = 1};
+	struct cmsghdr *cmsg;
+	ssize_t n;
+
+	if (!client->send_state_fds)
+		return send(client->fd, data, len, MSG_NOSIGNAL);
+
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+	if ((n = sendmsg(client->fd, &msg, MSG_NOSIGNAL)) > 0)
+		client->send_state_fds = false;
+	return n;
+}
+
+// 返回false表示连接已经断开并释放
+static bool ipc_client_flush(IpcClient *client) {
+	size_t chunk;
+	ssize_t n;
+	int event;
+
+	while (client->ring_len) {
+		chunk = MIN(client->ring_len, client->ring_cap - client->ring_head);
+		n = ipc_client_send(client, client->ring + client->ring_head, chunk);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		if (n < 0) {
+			ipc_client_destroy(client);
+			return false;
+		}
+		client->ring_head = (client->ring_head + n) % client->ring_cap;
+		client->ring_len -= n;
+
+		// 缓冲区腾出一半以上后补发之前被丢掉的事件的最新状态
+		if (client->dropped && client->ring_len < IPC_BUFFER_SIZE / 2) {
+			for (event = 0; event < IPC_EVENT_COUNT; event++) {
+				if (client->dropped & (1u << event))
+					ipc_client_queue_event(client, event, false);
+			}
+		}
+	}
+
+	wl_event_source_fd_update(client->source,
+							  WL_EVENT_READABLE |
+								  (client->ring_len ? WL_EVENT_WRITABLE : 0));
+	return true;
+}
+
+static void ipc_client_reply(IpcClient *client, bool success,
+							 const char *error) {
+	IpcBuf buf = {0};
+
+	ipc_buf_printf(&buf, "{\"success\":%s", success ? "true" : "false");
+	if (error) {
+		ipc_buf_printf(&buf, ",\"error\":");
+		ipc_buf_str(&buf, error);
+	}
+	ipc_buf_printf(&buf, "}\n");
+	ipc_client_queue(client, buf.data, buf.len, true);
+	free(buf.data);
+}
+
+// 把事件类名字解析成掩码,不认识的返回0
+static unsigned int ipc_parse_events(char *args) {
+	unsigned int mask = 0, found;
+	char *name, *save;
+	int event;
+
+	for (name = strtok_r(args, " \t", &save); name;
+		 name = strtok_r(NULL, " \t", &save)) {
+		if (strcmp(name, "all") == 0) {
+			mask |= IPC_EVENT_ALL;
+			continue;
+		}
+		found = 0;
+		for (event = 0; event < IPC_EVENT_COUNT; event++) {
+			if (strcmp(name, ipc_event_names[event]) == 0)
+				found = 1u << event;
+		}
+		if (!found)
+			return 0;
+		mask |= found;
+	}
+	return mask;
+}
+
+// 执行一条"函数名 参数..."形式的dispatch,函数名不认识时返回false
+static bool ipc_dispatch(char *spec) {
+	char *save, *argv[6] = {0};
+	void (*func)(const Arg *);
+	Arg arg;
+	int i;
+
+	for (i = 0; i < 6; i++) {
+		argv[i] = strtok_r(i ? NULL : spec, " \t", &save);
+		if (!argv[i])
+			break;
+	}
+	if (!argv[0])
+		return false;
+	for (i = 1; i < 6; i++) {
+		if (!argv[i])
+			argv[i] = "";
+	}
+
+	func = parse_func_name(argv[0], &arg, argv[1], argv[2], argv[3], argv[4],
+						   argv[5]);
+	if (!func)
+		return false;
+	func(&arg);
+	return true;
+}
+
+static void ipc_client_command(IpcClient *client, char *line) {
+	char *cmd, *args, *save, *spec;
+	unsigned int mask;
+	bool ok;
+	int event;
+
+	if ((cmd = strtok_r(line, " \t\r", &save)) == NULL)
+		return;
+	args = strtok_r(NULL, "\r", &save);
+
+	if (strcmp(cmd, "subscribe") == 0 || strcmp(cmd, "unsubscribe") == 0 ||
+		strcmp(cmd, "get") == 0) {
+		if (!args || !(mask = ipc_parse_events(args))) {
+			ipc_client_reply(client, false, "unknown event class");
+			return;
+		}
+		if (cmd[0] == 'u') {
+			client->subscriptions &= ~mask;
+		} else {
+			// 订阅和查询都先发一次当前状态
+			if (cmd[0] == 's') {
+				if (!(mask &= ~IPC_EVENT_GET_ONLY)) {
+					ipc_client_reply(client, false,
+									 "event class can only be queried");
+					return;
+				}
+				client->subscriptions |= mask;
+			}
+			for (event = 0; event < IPC_EVENT_COUNT; event++) {
+				if (mask & (1u << event))
+					ipc_client_queue_event(client, event, true);
+			}
+		}
+		ipc_client_reply(client, true, NULL);
+	} else if (strcmp(cmd, "dispatch") == 0) {
+		ok = args && ipc_dispatch(args);
+		ipc_client_reply(client, ok, ok ? NULL : "unknown dispatch");
+	} else if (strcmp(cmd, "batch") == 0) {
+		// 用;分隔的多条dispatch,全部执行完再统一arrange
+		ok = true;
+		dispatch_batch_begin();
+		for (spec = args ? strtok_r(args, ";", &save) : NULL; spec;
+			 spec = strtok_r(NULL, ";", &save)) {
+			if (!ipc_dispatch(spec))
+				ok = false;
+		}
+		dispatch_batch_end();
+		ipc_client_reply(client, ok, ok ? NULL : "unknown dispatch");
+	} else if (strcmp(cmd, "state") == 0) {
+		if (state_reader_fd() < 0) {
+			ipc_client_reply(client, false, "state block unavailable");
+			return;
+		}
+		if (client->state_eventfd < 0)
+			client->state_eventfd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+		if (client->state_eventfd < 0) {
+			ipc_client_reply(client, false, "eventfd failed");
+			return;
+		}
+		state_enable();
+		if (state_publish())
+			ipc_notify_state();
+		// fd跟着下一段发出去的数据一起到,读者用recvmsg接收
+		client->send_state_fds = true;
+		ipc_client_reply(client, true, NULL);
+	} else {
+		ipc_client_reply(client, false, "unknown command");
+	}
+}
+
+static int ipc_client_handle(int fd, uint32_t mask, void *data) {
+	IpcClient *client = data;
+	char *nl;
+	size_t consumed;
+	ssize_t n;
+
+	if (mask & WL_EVENT_WRITABLE && !ipc_client_flush(client))
+		return 0;
+
+	if (mask & WL_EVENT_READABLE) {
+		n = recv(fd, client->in + client->in_len,
+				 sizeof(client->in) - client->in_len, 0);
+		if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR)) {
+			ipc_client_destroy(client);
+			return 0;
+		}
+		if (n > 0)
+			client->in_len += n;
+
+		while ((nl = memchr(client->in, '\n', client->in_len))) {
+			*nl = '\0';
+			ipc_client_command(client, client->in);
+			consumed = nl - client->in + 1;
+			memmove(client->in, nl + 1, client->in_len - consumed);
+			client->in_len -= consumed;
+		}
+
+		// 一行超过缓冲区大小,当作非法客户端
+		if (client->in_len == sizeof(client->in)) {
+			ipc_client_destroy(client);
+			return 0;
+		}
+	} else if (mask & (WL_EVENT_HANGUP | WL_EVENT_ERROR)) {
+		ipc_client_destroy(client);
+		return 0;
+	}
+
+	ipc_client_flush(client);
+	return 0;
+}
+
+static int ipc_handle_accept(int fd, uint32_t mask, void *data) {
+	IpcClient *client;
+	int client_fd;
+
+	if ((client_fd = accept(fd, NULL, NULL)) < 0)
+		return 0;
+
+	if (fd_set_nonblock(client_fd) < 0 ||
+		fcntl(client_fd, F_SETFD, FD_CLOEXEC) < 0) {
+		close(client_fd);
+		return 0;
+	}
+
+	client = ecalloc(1, sizeof(*client));
+	client->fd = client_fd;
+	client->state_eventfd = -1;
+	client->source = wl_event_loop_add_fd(event_loop, client_fd,
+										  WL_EVENT_READABLE, ipc_client_handle,
+										  client);
+	wl_list_insert(&ipc_server.clients, &client->link);
+	return 0;
+}
+
+/* 在状态刷新点调用,对每一类有订阅者的事件生成一次,
+ * 跟上一次广播的内容相同就不发 */
+void ipc_broadcast(void) {
+	IpcClient *client, *tmp;
+	IpcBuf buf = {0};
+	unsigned int wanted = 0;
+	int event;
+
+	wl_list_for_each(client, &ipc_server.clients, link) {
+		wanted |= client->subscriptions;
+	}
+
+	for (event = 0; event < IPC_EVENT_COUNT; event++) {
+		if (!(wanted & (1u << event))) {
+			free(ipc_server.last[event]);
+			ipc_server.last[event] = NULL;
+			continue;
+		}
+
+		buf.len = 0;
+		ipc_serialize(&buf, event);
+		ipc_buf_printf(&buf, "\n");
+		if (ipc_server.last[event] &&
+			strcmp(ipc_server.last[event], buf.data) == 0)
+			continue;
+		free(ipc_server.last[event]);
+		ipc_server.last[event] = strdup(buf.data);
+
+		wl_list_for_each(client, &ipc_server.clients, link) {
+			if (!(client->subscriptions & (1u << event)))
+				continue;
+			if (ipc_client_queue(client, buf.data, buf.len, false))
+				client->dropped &= ~(1u << event);
+			else
+				client->dropped |= 1u << event;
+		}
+	}
+	free(buf.data);
+
+	wl_list_for_each_safe(client, tmp, &ipc_server.clients, link) {
+		if (client->ring_len)
+			ipc_client_flush(client);
+	}
+}
+
+// 共享内存状态块更新过,通知拿了eventfd的读者
+void ipc_notify_state(void) {
+	IpcClient *client;
+	uint64_t one = 1;
+
+	wl_list_for_each(client, &ipc_server.clients, link) {
+		if (client->state_eventfd >= 0 &&
+			write(client->state_eventfd, &one, sizeof(one)) < 0 &&
+			errno != EAGAIN)
+			wlr_log_errno(WLR_DEBUG, "ipc: eventfd write");
+	}
+}
+
+void ipc_init(void) {
+	struct sockaddr_un addr = {.sun_family = AF_UNIX};
+	const char *dir = getenv("XDG_RUNTIME_DIR");
+	const char *display = getenv("WAYLAND_DISPLAY");
+	int n;
+
+	wl_list_init(&ipc_server.clients);
+
+	if (!dir || !display) {
+		wlr_log(WLR_ERROR, "ipc: XDG_RUNTIME_DIR or WAYLAND_DISPLAY not set");
+		return;
+	}
+
+	n = snprintf(addr.sun_path, sizeof(addr.sun_path), "%s/maomao-%s.sock",
+				 dir, display);
+	if (n < 0 || (size_t)n >= sizeof(addr.sun_path)) {
+		wlr_log(WLR_ERROR, "ipc: socket path too long");
+		return;
+	}
+
+	if ((ipc_server.fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+		wlr_log_errno(WLR_ERROR, "ipc: socket");
+		return;
+	}
+	if (fd_set_nonblock(ipc_server.fd) < 0 ||
+		fcntl(ipc_server.fd, F_SETFD, FD_CLOEXEC) < 0) {
+		wlr_log_errno(WLR_ERROR, "ipc: fcntl");
+		goto fail;
+	}
+
+	unlink(addr.sun_path);
+	if (bind(ipc_server.fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+		listen(ipc_server.fd, 16) < 0) {
+		wlr_log_errno(WLR_ERROR, "ipc: bind %s", addr.sun_path);
+		goto fail;
+	}
+
+	ipc_server.source = wl_event_loop_add_fd(
+		event_loop, ipc_server.fd, WL_EVENT_READABLE, ipc_handle_accept, NULL);
+	strcpy(ipc_server.path, addr.sun_path);
+	setenv("MAOMAO_SOCKET", ipc_server.path, 1);
+	return;
+
+fail:
+	close(ipc_server.fd);
+	ipc_server.fd = -1;
+}
+
+void ipc_finish(void) {
+	IpcClient *client, *tmp;
+	int event;
+
+	wl_list_for_each_safe(client, tmp, &ipc_server.clients, link) {
+		ipc_client_destroy(client);
+	}
+
+	for (event = 0; event < IPC_EVENT_COUNT; event++) {
+		free(ipc_server.last[event]);
+		ipc_server.last[event] = NULL;
+	}
+
+	if (ipc_server.fd < 0)
+		return;
+
+	wl_event_source_remove(ipc_server.source);
+	close(ipc_server.fd);
+	unlink(ipc_server.path);
+	ipc_server.fd = -1;
+}
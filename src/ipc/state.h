@@ -0,0 +1,277 @@
+#include <stddef.h>
+#include <sys/mman.h>
+
+/*
+ * 共享内存里的状态快照,给状态栏之类只需要读状态的程序用.
+ * 通过ipc的state命令拿到只读fd和一个eventfd,mmap之后想多久读一次都行,
+ * 每次状态变化eventfd会加一,合成器这边没有按读者计算的开销.
+ *
+ * 布局: StateHeader, 然后是nmons个StateMonitor(从mon_offset开始),
+ * 再是nclients个StateClient(从client_offset开始).
+ * 整个块的大小在header.size里,比自己mmap的大时需要重新mmap.
+ *
+ * 读者按seqlock的方式读:
+ *   do {
+ *       seq = atomic_load_acquire(&header->seq);
+ *       if (seq & 1) continue;
+ *       拷贝需要的数据;
+ *       atomic_thread_fence(acquire);
+ *   } while (seq != atomic_load_relaxed(&header->seq));
+ */
+
+#define STATE_MAGIC 0x54534d4d /* "MMST" */
+#define STATE_VERSION 1
+#define STATE_MAX_TAGS 32
+
+enum {
+	StateClientFocused = 1 << 0,
+	StateClientFloating = 1 << 1,
+	StateClientFullscreen = 1 << 2,
+	StateClientMinimized = 1 << 3,
+	StateClientUrgent = 1 << 4,
+};
+
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t seq; /* 奇数表示正在写 */
+	uint32_t size;
+	/* 以下内容只在seq为偶数且前后一致时有效 */
+	uint32_t nmons, mon_offset, mon_size;
+	uint32_t nclients, client_offset, client_size;
+	uint32_t ntags;
+	int32_t selmon;			 /* 当前显示器在显示器表里的序号,-1为没有 */
+	uint32_t focused_client; /* 焦点窗口的id,0为没有 */
+} StateHeader;
+
+typedef struct {
+	char name[32];
+	int32_t x, y, width, height;
+	uint32_t enabled;
+	uint32_t active_tags, occupied_tags, urgent_tags;
+	uint32_t layout; /* layouts[]里的序号 */
+	uint32_t isoverview;
+	uint32_t focused_client;
+	uint32_t nclients[STATE_MAX_TAGS];
+} StateMonitor;
+
+typedef struct {
+	uint32_t id; /* 跟socket ipc里的窗口id一致 */
+	uint32_t tags;
+	int32_t mon; /* 显示器表里的序号,-1为没有 */
+	uint32_t flags;
+	int32_t x, y, width, height;
+	char appid[64];
+	char title[128];
+} StateClient;
+
+static struct {
+	int fd, ro_fd; /* ro_fd是发给读者的只读fd */
+	uint8_t *map;
+	size_t size;
+	uint8_t *scratch; /* 先生成到这里,跟上一次的内容一样就不写 */
+	size_t scratch_cap;
+	bool enabled; /* 第一个读者请求之前不生成 */
+} state_block = {.fd = -1, .ro_fd = -1};
+
+void state_init(void) {
+	char name[64], path[64];
+	static unsigned int counter;
+
+	// shm_open之后马上unlink,跟memfd一样是匿名的
+	do {
+		snprintf(name, sizeof(name), "/maomao-state-%d-%u", getpid(),
+				 counter++);
+		state_block.fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	} while (state_block.fd < 0 && errno == EEXIST);
+
+	if (state_block.fd < 0) {
+		wlr_log_errno(WLR_ERROR, "state: shm_open");
+		return;
+	}
+	shm_unlink(name);
+
+	// 通过/proc重新以只读方式打开,读者拿到的fd不能写
+	snprintf(path, sizeof(path), "/proc/self/fd/%d", state_block.fd);
+	if ((state_block.ro_fd = open(path, O_RDONLY | O_CLOEXEC)) < 0) {
+		wlr_log_errno(WLR_ERROR, "state: reopen read-only");
+		close(state_block.fd);
+		state_block.fd = -1;
+	}
+}
+
+void state_finish(void) {
+	if (state_block.map)
+		munmap(state_block.map, state_block.size);
+	if (state_block.fd >= 0)
+		close(state_block.fd);
+	if (state_block.ro_fd >= 0)
+		close(state_block.ro_fd);
+	free(state_block.scratch);
+	state_block.map = NULL;
+	state_block.scratch = NULL;
+	state_block.enabled = false;
+	state_block.size = state_block.scratch_cap = 0;
+	state_block.fd = state_block.ro_fd = -1;
+}
+
+int state_reader_fd(void) { return state_block.ro_fd; }
+
+void state_enable(void) { state_block.enabled = true; }
+
+static void state_copy_str(char *dst, size_t size, const char *src) {
+	if (src)
+		snprintf(dst, size, "%s", src);
+}
+
+static size_t state_serialize(void) {
+	StateHeader *hdr;
+	StateMonitor *sm;
+	StateClient *sc;
+	Monitor *m;
+	Client *c, *focused;
+	size_t size;
+	unsigned int nmons = 0, nclients = 0, i, mon_index;
+
+	wl_list_for_each(m, &mons, link) { nmons++; }
+	wl_list_for_each(c, &clients, link) {
+		if (!c->iskilling && !client_is_unmanaged(c))
+			nclients++;
+	}
+
+	size = sizeof(StateHeader) + nmons * sizeof(StateMonitor) +
+		   nclients * sizeof(StateClient);
+	if (size > state_block.scratch_cap) {
+		free(state_block.scratch);
+		state_block.scratch_cap = MAX(size, state_block.scratch_cap * 2);
+		state_block.scratch = ecalloc(1, state_block.scratch_cap);
+	}
+	memset(state_block.scratch, 0, size);
+
+	focused = selmon ? focustop(selmon) : NULL;
+	hdr = (StateHeader *)state_block.scratch;
+	hdr->nmons = nmons;
+	hdr->mon_offset = sizeof(StateHeader);
+	hdr->mon_size = sizeof(StateMonitor);
+	hdr->nclients = nclients;
+	hdr->client_offset = sizeof(StateHeader) + nmons * sizeof(StateMonitor);
+	hdr->client_size = sizeof(StateClient);
+	hdr->ntags = MIN(LENGTH(tags), STATE_MAX_TAGS);
+	hdr->selmon = -1;
+	hdr->focused_client = focused ? ipc_client_id(focused) : 0;
+
+	sm = (StateMonitor *)(state_block.scratch + hdr->mon_offset);
+	mon_index = 0;
+	wl_list_for_each(m, &mons, link) {
+		if (m == selmon)
+			hdr->selmon = mon_index;
+		state_copy_str(sm->name, sizeof(sm->name), m->wlr_output->name);
+		sm->x = m->m.x;
+		sm->y = m->m.y;
+		sm->width = m->m.width;
+		sm->height = m->m.height;
+		sm->enabled = m->wlr_output->enabled;
+		sm->active_tags = m->tagset[m->seltags];
+		sm->layout = m->pertag->ltidxs[m->pertag->curtag] - layouts;
+		sm->isoverview = m->isoverview;
+		c = focustop(m);
+		sm->focused_client = c ? ipc_client_id(c) : 0;
+		for (i = 0; i < hdr->ntags; i++) {
+			sm->nclients[i] = m->pertag->nclients[i];
+			if (m->pertag->nclients[i])
+				sm->occupied_tags |= 1 << i;
+			if (m->pertag->nurgent[i])
+				sm->urgent_tags |= 1 << i;
+		}
+		sm++;
+		mon_index++;
+	}
+
+	sc = (StateClient *)(state_block.scratch + hdr->client_offset);
+	wl_list_for_each(c, &clients, link) {
+		if (c->iskilling || client_is_unmanaged(c))
+			continue;
+		sc->id = ipc_client_id(c);
+		sc->tags = c->tags;
+		sc->mon = -1;
+		mon_index = 0;
+		wl_list_for_each(m, &mons, link) {
+			if (m == c->mon) {
+				sc->mon = mon_index;
+				break;
+			}
+			mon_index++;
+		}
+		sc->flags = (c == focused ? StateClientFocused : 0) |
+					(c->isfloating ? StateClientFloating : 0) |
+					(c->isfullscreen ? StateClientFullscreen : 0) |
+					(c->isminied ? StateClientMinimized : 0) |
+					(c->isurgent ? StateClientUrgent : 0);
+		sc->x = c->geom.x;
+		sc->y = c->geom.y;
+		sc->width = c->geom.width;
+		sc->height = c->geom.height;
+		state_copy_str(sc->appid, sizeof(sc->appid), client_get_appid(c));
+		state_copy_str(sc->title, sizeof(sc->title), client_get_title(c));
+		sc++;
+	}
+
+	return size;
+}
+
+static bool state_grow(size_t size) {
+	size_t page = sysconf(_SC_PAGESIZE), cap;
+	uint8_t *map;
+
+	cap = MAX(size, state_block.size * 2);
+	cap = (cap + page - 1) / page * page;
+
+	// 只会变大,旧的映射在读者那边仍然有效
+	if (ftruncate(state_block.fd, cap) < 0) {
+		wlr_log_errno(WLR_ERROR, "state: ftruncate");
+		return false;
+	}
+	map = mmap(NULL, cap, PROT_READ | PROT_WRITE, MAP_SHARED, state_block.fd,
+			   0);
+	if (map == MAP_FAILED) {
+		wlr_log_errno(WLR_ERROR, "state: mmap");
+		return false;
+	}
+	if (state_block.map)
+		munmap(state_block.map, state_block.size);
+	state_block.map = map;
+	state_block.size = cap;
+	return true;
+}
+
+/* 在状态刷新点调用,内容有变化时写进共享内存并返回true */
+bool state_publish(void) {
+	StateHeader *hdr;
+	size_t size, body = offsetof(StateHeader, nmons);
+	uint32_t seq;
+
+	if (state_block.fd < 0 || !state_block.enabled)
+		return false;
+
+	size = state_serialize();
+	if (size <= state_block.size &&
+		memcmp(state_block.map + body, state_block.scratch + body,
+			   size - body) == 0)
+		return false;
+
+	if (size > state_block.size && !state_grow(size))
+		return false;
+
+	hdr = (StateHeader *)state_block.map;
+	seq = hdr->seq;
+	__atomic_store_n(&hdr->seq, seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	memcpy(state_block.map + body, state_block.scratch + body, size - body);
+	hdr->magic = STATE_MAGIC;
+	hdr->version = STATE_VERSION;
+	hdr->size = state_block.size;
+
+	__atomic_store_n(&hdr->seq, seq + 2, __ATOMIC_RELEASE);
+	return true;
+}
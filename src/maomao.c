@@ -3,6 +3,7 @@
  */
 #include "wlr-layer-shell-unstable-v1-protocol.h"
 #include "wlr/util/box.h"
+#include <fcntl.h>
 #include <getopt.h>
 #include <libinput.h>
 #include <limits.h>
@@ -11,12 +12,15 @@
 #include <scenefx/types/fx/blur_data.h>
 #include <scenefx/types/fx/clipped_region.h>
 #include <scenefx/types/fx/corner_location.h>
+#include <poll.h>
 #include <scenefx/types/wlr_scene.h>
 #include <signal.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
 #include <sys/wait.h>
 #include <time.h>
 #include <unistd.h>
@@ -27,6 +31,7 @@
 #include <wlr/backend/multi.h>
 #include <wlr/backend/wayland.h>
 #include <wlr/interfaces/wlr_keyboard.h>
+#include <wlr/interfaces/wlr_pointer.h>
 #include <wlr/render/allocator.h>
 #include <wlr/render/wlr_renderer.h>
 #include <wlr/types/wlr_alpha_modifier_v1.h>
@@ -226,23 +231,100 @@ typedef struct {
 } animationScale;
 
 typedef struct Client Client;
+
+typedef struct {
+	struct wl_list link; /* Pertag::tag_clients */
+	Client *c;
+} TagLink;
+
+typedef struct {
+	uint64_t commits;
+	uint64_t window_start_ns; /* 当前这一秒统计窗口的开始时间 */
+	unsigned int window_commits;
+	uint64_t window_damage;
+	double commit_rate; /* 上一个统计窗口里每秒的提交次数 */
+	double damage_rate; /* 上一个统计窗口里每秒的damage面积 */
+	int buffer_width, buffer_height;
+	uint64_t damage_area;			/* 最近一次提交的damage面积 */
+	unsigned int configure_pending; /* 第一个还没确认的configure的serial */
+	uint64_t configure_sent_ns;
+	uint64_t configure_latency_ns;
+	double configure_latency_avg_ns;
+} ClientCommitStats;
+
+/* 很少访问的窗口数据,单独分配,遍历窗口时不会带进缓存 */
+typedef struct {
+	struct wlr_box overview_backup_geom;
+	int overview_backup_bw;
+	int overview_isfloatingbak;
+	int is_in_scratchpad, is_scratchpad_show;
+	struct wlr_box bounds;
+	unsigned int mini_restore_tag;
+	int scratchpad_width, scratchpad_height;
+	char oldmonname[128];
+	ClientCommitStats commit_stats;
+} ClientCold;
+
 struct Client {
 	/* Must keep these three elements in this order */
 	unsigned int type; /* XDGShell or X11* */
-	struct wlr_box geom, pending, oldgeom, animainit_geom, overview_backup_geom,
-		current; /* layout-relative, includes border */
+	struct wlr_box geom; /* layout-relative, includes border */
 	Monitor *mon;
+	/* 布局和每一帧都要读的字段放在前面挨在一起,
+	 * 遍历clients用的link和VISIBLEON,ISTILED的前几项在第一个缓存行 */
+	struct wl_list link;
+	unsigned int tags;
+	unsigned int bw;
+	int isfloating, isfullscreen, ismaxmizescreen, isminied, isoverlay;
+	int isglobal, isunglobal, iskilling;
+	/* ISFULLSCREEN要读,留在这里 */
+	bool overview_isfullscreenbak, overview_ismaxmizescreenbak;
+	bool dirty;
+	bool need_output_flush;
+	bool is_clip_to_hide;
+	bool is_pending_open_animation;
+	bool frame_done_held; /* 这一帧的帧回调被限制扣下了 */
+	struct dwl_animation animation;
+	float scroller_proportion;
+	float focused_opacity;
+	float unfocused_opacity;
+	struct wlr_box pending, current, animainit_geom;
 	struct wlr_scene_tree *scene;
 	struct wlr_scene_rect *border; /* top, bottom, left, right */
 	struct wlr_scene_shadow *shadow;
 	struct wlr_scene_tree *scene_surface;
-	struct wl_list link;
 	struct wl_list flink;
-	struct wl_list fadeout_link;
 	union {
 		struct wlr_xdg_surface *xdg;
 		struct wlr_xwayland_surface *xwayland;
 	} surface;
+	TagLink *tag_links; /* 每个标签一个节点,最后一个用于global窗口 */
+	Monitor *index_mon;
+	unsigned int index_tags;
+	struct wl_list tag_changed_link; /* Monitor::tag_changed_clients */
+	unsigned int arrange_serial;
+	int max_frame_rate; /* 窗口规则限制的帧回调频率,0为不限制 */
+	uint64_t last_frame_done_ns;
+	ClientCold *cold;
+
+	/* 下面的只在处理事件和规则的时候用到 */
+	struct wlr_box oldgeom;
+	unsigned int oldtags;
+	unsigned int configure_serial;
+	int isurgent, isfakefullscreen, need_float_size_reduce;
+	int isnoborder, isopensilent, isnamedscratchpad;
+	bool is_restoring_from_ov;
+	bool drag_to_tile;
+	bool fake_no_border;
+	int isterm, noswallow;
+	int nofadein, nofadeout, no_force_center;
+	pid_t pid;
+	Client *swallowing, *swallowedby;
+	const char *animation_type_open;
+	const char *animation_type_close;
+	unsigned int ipc_id; /* socket ipc里的窗口编号,第一次用到时分配 */
+	struct wlr_foreign_toplevel_handle_v1 *foreign_toplevel;
+	struct wlr_xdg_toplevel_decoration_v1 *decoration;
 	struct wl_listener commit;
 	struct wl_listener map;
 	struct wl_listener maximize;
@@ -259,63 +341,28 @@ struct Client {
 	struct wl_listener set_hints;
 	struct wl_listener set_geometry;
 #endif
-	unsigned int bw;
-	unsigned int tags, oldtags, mini_restore_tag;
-	bool dirty;
-	unsigned int configure_serial;
-	struct wlr_foreign_toplevel_handle_v1 *foreign_toplevel;
-	int isfloating, isurgent, isfullscreen, isfakefullscreen,
-		need_float_size_reduce, isminied, isoverlay;
-	int ismaxmizescreen;
-	int overview_backup_bw;
-	int fullscreen_backup_x, fullscreen_backup_y, fullscreen_backup_w,
-		fullscreen_backup_h;
-	int overview_isfullscreenbak, overview_ismaxmizescreenbak,
-		overview_isfloatingbak;
 
-	struct wlr_xdg_toplevel_decoration_v1 *decoration;
 	struct wl_listener foreign_activate_request;
 	struct wl_listener foreign_fullscreen_request;
 	struct wl_listener foreign_close_request;
 	struct wl_listener foreign_destroy;
 	struct wl_listener set_decoration_mode;
 	struct wl_listener destroy_decoration;
-
-	const char *animation_type_open;
-	const char *animation_type_close;
-	int is_in_scratchpad;
-	int is_scratchpad_show;
-	int isglobal;
-	int isnoborder;
-	int isopensilent;
-	int iskilling;
-	int isnamedscratchpad;
-	struct wlr_box bounds;
-	bool is_pending_open_animation;
-	bool is_restoring_from_ov;
-	float scroller_proportion;
-	bool need_output_flush;
-	struct dwl_animation animation;
-	int isterm, noswallow;
-	pid_t pid;
-	Client *swallowing, *swallowedby;
-	bool is_clip_to_hide;
-	bool drag_to_tile;
-	bool fake_no_border;
-	int nofadein;
-	int nofadeout;
-	int no_force_center;
-	int isunglobal;
-	float focused_opacity;
-	float unfocused_opacity;
-	char oldmonname[128];
-	int scratchpad_width, scratchpad_height;
 };
 
+typedef struct {
+	unsigned int state, clients, focused;
+} DwlIpcTagState;
+
 typedef struct {
 	struct wl_list link;
 	struct wl_resource *resource;
 	Monitor *mon;
+	/* 上一次发给这个resource的状态,只发送有变化的字段 */
+	bool sent;
+	int active, layout, fullscreen, floating, x, y, width, height;
+	DwlIpcTagState *tag_states;
+	char *title, *appid, *symbol, *last_layer;
 } DwlIpcOutput;
 
 typedef struct {
@@ -325,13 +372,17 @@ typedef struct {
 	const Arg arg;
 } Key;
 
+#define KEY_REPEAT_BINDINGS_MAX 8
+#define KEY_REPEAT_CATCHUP_MAX 3 /* 卡顿之后最多补发这么多次 */
+
 typedef struct {
 	struct wlr_keyboard_group *wlr_group;
 
-	int nsyms;
-	const xkb_keysym_t *keysyms; /* invalid if nsyms == 0 */
-	unsigned int mods;			 /* invalid if nsyms == 0 */
-	unsigned int keycode;
+	/* 按下时匹配到的快捷键在config.key_bindings里的下标,重复时直接调用 */
+	int repeat_bindings[KEY_REPEAT_BINDINGS_MAX];
+	int nrepeat;
+	unsigned int repeat_serial; /* 按下时的bindings_serial */
+	int key_repeat_fd;			/* 绝对时间的timerfd */
 	struct wl_event_source *key_repeat_source;
 
 	struct wl_listener modifiers;
@@ -339,17 +390,10 @@ typedef struct {
 	struct wl_listener destroy;
 } KeyboardGroup;
 
+/* kb_group里的物理键盘,切换布局时要改成员键盘的状态 */
 typedef struct {
 	struct wl_list link;
 	struct wlr_keyboard *wlr_keyboard;
-
-	int nsyms;
-	const xkb_keysym_t *keysyms; /* invalid if nsyms == 0 */
-	unsigned int mods;			 /* invalid if nsyms == 0 */
-	struct wl_event_source *key_repeat_source;
-
-	struct wl_listener modifiers;
-	struct wl_listener key;
 	struct wl_listener destroy;
 } Keyboard;
 
@@ -363,7 +407,6 @@ typedef struct {
 	struct wlr_scene_shadow *shadow;
 	struct wlr_scene_layer_surface_v1 *scene_layer;
 	struct wl_list link;
-	struct wl_list fadeout_link;
 	int mapped;
 	struct wlr_layer_surface_v1 *layer_surface;
 
@@ -382,17 +425,49 @@ typedef struct {
 	bool need_output_flush;
 } LayerSurface;
 
+/* 窗口和layer关闭动画用的快照,只留动画需要的字段,
+ * 用完放回fadeout_pool,不用每次关窗都分配 */
+typedef struct {
+	struct wl_list link; /* fadeout_clients, fadeout_layers或fadeout_pool */
+	struct wlr_scene_tree *scene;
+	struct wlr_box current; /* 动画终点,相对快照节点的坐标 */
+	struct dwl_animation animation;
+	const char *animation_type_close;
+	int nofadeout;
+} FadeoutSnapshot;
+
 typedef struct {
 	const char *symbol;
 	void (*arrange)(Monitor *);
 	const char *name;
 } Layout;
 
+#define FRAME_HIST_BUCKETS 16
+
+typedef struct {
+	uint64_t count;
+	uint64_t last_ns, min_ns, max_ns;
+	double avg_ns; /* 滑动平均 */
+	unsigned int hist[FRAME_HIST_BUCKETS]; /* 按2的幂分桶,第一个桶是64us以下 */
+} FrameStat;
+
+typedef struct {
+	FrameStat animate;			/* 推进动画和更新场景 */
+	FrameStat commit;			/* wlr_scene_output_commit */
+	FrameStat frame_to_commit;	/* 触发这一帧的vblank到commit完成 */
+	FrameStat present_interval; /* 连续出帧时两次present的间隔 */
+	uint64_t frames, missed;	/* missed是连续出帧时错过的vblank数 */
+	uint64_t last_present_ns, refresh_ns;
+	bool want_next; /* 上一帧结束时还要继续出帧 */
+	bool chained;	/* 这一帧是上一帧直接请求的 */
+} FrameStats;
+
 struct Monitor {
 	struct wl_list link;
 	struct wlr_output *wlr_output;
 	struct wlr_scene_output *scene_output;
 	struct wl_listener frame;
+	struct wl_listener present;
 	struct wl_listener destroy;
 	struct wl_listener request_state;
 	struct wl_listener destroy_lock_surface;
@@ -421,6 +496,11 @@ struct Monitor {
 	unsigned int visible_tiling_clients;
 	struct wlr_scene_optimized_blur *blur;
 	char last_surface_ws_name[256];
+	struct wl_list tag_changed_clients; /* 上次arrange后标签变动过的窗口 */
+	unsigned int arranged_tagset;
+	FrameStats frame_stats;
+	bool arrange_pending; /* 批量dispatch期间推迟的arrange */
+	bool arrange_pending_animation;
 };
 
 typedef struct {
@@ -435,6 +515,7 @@ typedef struct {
 
 typedef struct {
 	struct wlr_pointer_constraint_v1 *constraint;
+	struct wlr_addon addon; /* 挂在constraint->surface上,按surface查找 */
 	struct wl_listener destroy;
 } PointerConstraint;
 
@@ -462,6 +543,14 @@ typedef struct {
 	struct wl_listener destroy;
 } SessionLock;
 
+typedef struct {
+	struct wlr_surface *surface;
+	int width, height;	  /* 上一次提交后的大小 */
+	uint32_t subsurfaces; /* 子表面顺序和位置,popup位置的摘要 */
+	struct wl_listener commit;
+	struct wl_listener destroy;
+} SurfaceWatch;
+
 /* function declarations */
 static void applybounds(
 	Client *c,
@@ -473,6 +562,12 @@ arrange(Monitor *m,
 static void arrangelayer(Monitor *m, struct wl_list *list,
 						 struct wlr_box *usable_area, int exclusive);
 static void arrangelayers(Monitor *m);
+static void dispatch_batch_begin(void);
+static void dispatch_batch_end(void);
+static bool state_publish(void);
+static int state_reader_fd(void);
+static void state_enable(void);
+static void ipc_notify_state(void);
 static char *get_autostart_path(char *, unsigned int); // 自启动命令执行
 static void axisnotify(struct wl_listener *listener,
 					   void *data); // 滚轮事件处理
@@ -501,6 +596,9 @@ static void commitnotify(struct wl_listener *listener, void *data);
 static void createdecoration(struct wl_listener *listener, void *data);
 static void createidleinhibitor(struct wl_listener *listener, void *data);
 static void createkeyboard(struct wlr_keyboard *keyboard);
+static struct xkb_keymap *compile_keymap(void);
+static void keymap_cache_finish(void);
+static void set_keyboard_layout_group(xkb_layout_index_t group);
 static void requestmonstate(struct wl_listener *listener, void *data);
 static void createlayersurface(struct wl_listener *listener, void *data);
 static void createlocksurface(struct wl_listener *listener, void *data);
@@ -509,8 +607,14 @@ static void createnotify(struct wl_listener *listener, void *data);
 static void createpointer(struct wlr_pointer *pointer);
 static void createpointerconstraint(struct wl_listener *listener, void *data);
 static void cursorconstrain(struct wlr_pointer_constraint_v1 *constraint);
+static struct wlr_pointer_constraint_v1 *
+pointerconstraint_for_surface(struct wlr_surface *surface);
+static void pointerconstraintupdate(void);
+static void pointerfocuschange(struct wl_listener *listener, void *data);
 static void commitpopup(struct wl_listener *listener, void *data);
+static void commitsurface(struct wl_listener *listener, void *data);
 static void createpopup(struct wl_listener *listener, void *data);
+static void createsurface(struct wl_listener *listener, void *data);
 static void cursorframe(struct wl_listener *listener, void *data);
 static void cursorwarptohint(void);
 static void destroydecoration(struct wl_listener *listener, void *data);
@@ -522,6 +626,7 @@ static void destroylocksurface(struct wl_listener *listener, void *data);
 static void destroynotify(struct wl_listener *listener, void *data);
 static void destroypointerconstraint(struct wl_listener *listener, void *data);
 static void destroysessionlock(struct wl_listener *listener, void *data);
+static void destroysurface(struct wl_listener *listener, void *data);
 static void destroykeyboardgroup(struct wl_listener *listener, void *data);
 static Monitor *dirtomon(enum wlr_direction dir);
 static void setcursorshape(struct wl_listener *listener, void *data);
@@ -533,10 +638,12 @@ static Client *focustop(Monitor *m);
 static void fullscreennotify(struct wl_listener *listener, void *data);
 static void gpureset(struct wl_listener *listener, void *data);
 
-static int keyrepeat(void *data);
+static int keyrepeat(int fd, uint32_t mask, void *data);
+static void key_repeat_start(KeyboardGroup *group);
+static void key_repeat_stop(KeyboardGroup *group);
 
 static void inputdevice(struct wl_listener *listener, void *data);
-static int keybinding(unsigned int mods, xkb_keysym_t sym,
+static int keybinding(KeyboardGroup *group, unsigned int mods, xkb_keysym_t sym,
 					  unsigned int keycode);
 static void keypress(struct wl_listener *listener, void *data);
 static void keypressmod(struct wl_listener *listener, void *data);
@@ -566,9 +673,16 @@ static void outputmgrtest(struct wl_listener *listener, void *data);
 static void pointerfocus(Client *c, struct wlr_surface *surface, double sx,
 						 double sy, unsigned int time);
 static void printstatus(void);
+static void flush_status(void *data);
 static void quitsignal(int signo);
 static void powermgrsetmode(struct wl_listener *listener, void *data);
 static void rendermon(struct wl_listener *listener, void *data);
+static void presentmon(struct wl_listener *listener, void *data);
+static void frame_stats_schedule_log(void);
+static void client_stats_commit(Client *c);
+static void client_stats_configure(Client *c, uint32_t serial);
+static int frame_throttle_timeout(void *data);
+static void send_frame_done(Monitor *m, struct timespec *now);
 static void requestdecorationmode(struct wl_listener *listener, void *data);
 static void requeststartdrag(struct wl_listener *listener, void *data);
 static void resize(Client *c, struct wlr_box geo, int interact);
@@ -605,9 +719,20 @@ static void xytonode(double x, double y, struct wlr_surface **psurface,
 					 Client **pc, LayerSurface **pl, double *nx, double *ny);
 static void clear_fullscreen_flag(Client *c);
 static pid_t getparentprocess(pid_t p);
+static void ppid_cache_clear(void);
+static void launch_stats_present(Monitor *m, uint64_t when);
+static void launch_stats_animation_done(Client *c);
 static int isdescprocess(pid_t p, pid_t c);
 static Client *termforwin(Client *w);
 static void swallow(Client *c, Client *w);
+static void client_attach_tagindex(Client *c);
+static void client_set_urgent(Client *c, int urgent);
+static void client_detach_tagindex(Client *c);
+static void client_update_tagindex(Client *c);
+static void client_remove_tagindex(Client *c);
+static bool tagindex_has_clients(Monitor *m, unsigned int tagmask);
+static void arrange_client(Monitor *m, Client *c, bool want_animation);
+static void spatial_index_invalidate(void);
 
 static void warp_cursor_to_selmon(Monitor *m);
 unsigned int want_restore_fullscreen(Client *target_client);
@@ -645,12 +770,18 @@ static void set_rect_size(struct wlr_scene_rect *rect, int width, int height);
 static Client *center_select(Monitor *m);
 static void handlecursoractivity(void);
 static int hidecursor(void *data);
+static void schedule_pointer_refocus(void);
+static void schedule_idle_inhibit_check(void);
+static void flush_deferred_focus(void *data);
 static bool check_hit_no_border(Client *c);
 static void reset_keyboard_layout(void);
 static void client_update_oldmonname_record(Client *c, Monitor *m);
 static void pending_kill_client(Client *c);
 static void set_layer_open_animaiton(LayerSurface *l, struct wlr_box geo);
+static uint64_t monotonic_ns(void);
 static void init_fadeout_layers(LayerSurface *l);
+static FadeoutSnapshot *fadeout_snapshot_get(void);
+static void fadeout_snapshot_put(FadeoutSnapshot *s);
 static void layer_actual_size(LayerSurface *l, unsigned int *width,
 							  unsigned int *height);
 static void get_layer_target_geometry(LayerSurface *l,
@@ -668,13 +799,24 @@ wlr_scene_tree_snapshot(struct wlr_scene_node *node,
 						struct wlr_scene_tree *parent);
 static bool is_scroller_layout(Monitor *m);
 
-#include "data/static_keymap.h"
 #include "dispatch/dispatch.h"
 #include "layout/layout.h"
+#include "trace/trace.h"
 
 /* variables */
 static const char broken[] = "broken";
 static pid_t child_pid = -1;
+/* pid到父进程pid的缓存,窗口吞噬判断用,开放寻址.
+ * 每项的pidfd挂在事件循环上,进程退出后pidfd可读,回调里把这一项作废,
+ * pid被复用也不会查到旧的父进程,查询本身不用系统调用 */
+#define PPID_CACHE_SIZE 256 /* 必须是2的幂 */
+typedef struct {
+	pid_t pid, ppid;
+	struct wl_event_source *exit_source; /* NULL为不可信,下次查询重新读 */
+} PpidCacheEntry;
+static PpidCacheEntry ppid_cache[PPID_CACHE_SIZE];
+static unsigned int ppid_cache_count;
+static int proc_fd = -1;
 static int locked;
 static unsigned int locked_mods = 0;
 static void *exclusive_focus;
@@ -696,6 +838,8 @@ static struct wl_list clients; /* tiling order */
 static struct wl_list fstack;  /* focus order */
 static struct wl_list fadeout_clients;
 static struct wl_list fadeout_layers;
+static struct wl_list fadeout_pool;
+static unsigned int fadeout_pool_size;
 static struct wlr_idle_notifier_v1 *idle_notifier;
 static struct wlr_idle_inhibit_manager_v1 *idle_inhibit_mgr;
 static struct wlr_layer_shell_v1 *layer_shell;
@@ -723,7 +867,20 @@ static struct wlr_pointer_constraint_v1 *active_constraint;
 static struct wlr_seat *seat;
 static KeyboardGroup *kb_group;
 static struct wl_list keyboards;
+static unsigned int bindings_serial; /* 每次释放绑定配置时递增 */
+/* 编译好的keymap按xkb规则缓存,虚拟键盘和重载配置时规则没变就直接复用 */
+#define KEYMAP_CACHE_SIZE 4
+static struct {
+	char names[5 * 256 + 5]; /* rules,model,layout,variant,options */
+	struct xkb_keymap *keymap;
+} keymap_cache[KEYMAP_CACHE_SIZE];
+static unsigned int keymap_cache_next;
+static struct xkb_context *keymap_context;
 static unsigned int cursor_mode;
+static unsigned int arrange_serial; /* arrange() 中窗口去重 */
+/* 场景里的节点移动,改变大小,换父节点,显示隐藏时递增,
+ * xytonode()用它判断命中缓存是否还有效 */
+static unsigned int scene_generation = 1;
 static Client *grabc;
 static int grabcx, grabcy; /* client-relative */
 
@@ -740,6 +897,7 @@ static int scroller_focus_lock = 0;
 static unsigned int swipe_fingers = 0;
 static double swipe_dx = 0;
 static double swipe_dy = 0;
+static bool swipe_client_cancelled = false; /* 被swipe_track接管,不再转发 */
 
 bool render_border = true;
 
@@ -750,6 +908,12 @@ struct dvec2 *baked_points_close;
 
 static struct wl_event_source *hide_source;
 static bool cursor_hidden = false;
+/* 指针焦点和idle inhibit在事件循环空闲时统一处理一次 */
+static struct wl_event_source *deferred_focus_source;
+static bool pointer_focus_dirty = false;
+static bool idle_inhibit_dirty = false;
+static struct wl_event_source *status_source; /* printstatus()合并发送 */
+static unsigned int dispatch_batch_depth = 0; /* 大于0时arrange推迟到批量结束 */
 static struct {
 	enum wp_cursor_shape_device_v1_shape shape;
 	struct wlr_surface *surface;
@@ -767,6 +931,10 @@ struct Pertag {
 	float smfacts[LENGTH(tags) + 1]; /* smfacts per tag */
 	const Layout
 		*ltidxs[LENGTH(tags) + 1]; /* matrix of tags and layouts indexes  */
+	struct wl_list
+		tag_clients[LENGTH(tags) + 1]; /* TagLink::link, 最后一个是global窗口 */
+	unsigned int nclients[LENGTH(tags)]; /* tag_clients里的窗口数 */
+	unsigned int nurgent[LENGTH(tags)];	 /* 其中isurgent的窗口数 */
 };
 
 static struct wl_listener cursor_axis = {.notify = axisnotify};
@@ -782,11 +950,13 @@ static struct wl_listener new_virtual_keyboard = {.notify = virtualkeyboard};
 static struct wl_listener new_virtual_pointer = {.notify = virtualpointer};
 static struct wl_listener new_pointer_constraint = {
 	.notify = createpointerconstraint};
+static struct wl_listener pointer_focus_change = {.notify = pointerfocuschange};
 static struct wl_listener new_output = {.notify = createmon};
 static struct wl_listener new_xdg_toplevel = {.notify = createnotify};
 static struct wl_listener new_xdg_popup = {.notify = createpopup};
 static struct wl_listener new_xdg_decoration = {.notify = createdecoration};
 static struct wl_listener new_layer_surface = {.notify = createlayersurface};
+static struct wl_listener new_surface = {.notify = createsurface};
 static struct wl_listener output_mgr_apply = {.notify = outputmgrapply};
 static struct wl_listener output_mgr_test = {.notify = outputmgrtest};
 static struct wl_listener output_power_mgr_set_mode = {.notify =
@@ -806,6 +976,7 @@ static void configurex11(struct wl_listener *listener, void *data);
 static void createnotifyx11(struct wl_listener *listener, void *data);
 static void dissociatex11(struct wl_listener *listener, void *data);
 static void associatex11(struct wl_listener *listener, void *data);
+static void commitx11(struct wl_listener *listener, void *data);
 static void sethints(struct wl_listener *listener, void *data);
 static void xwaylandready(struct wl_listener *listener, void *data);
 static void setgeometrynotify(struct wl_listener *listener, void *data);
@@ -817,8 +988,17 @@ static struct wlr_xwayland *xwayland;
 #include "animation/client.h"
 #include "animation/common.h"
 #include "animation/layer.h"
+#include "animation/swipe.h"
 #include "config/parse_config.h"
 #include "ext-protocol/all.h"
+#include "trace/frame_stats.h"
+#include "trace/launch_stats.h"
+#include "trace/client_stats.h"
+#include "trace/input_record.h"
+#include "ipc/ipc.h"
+#include "ipc/state.h"
+#include "common/launcher.h"
+#include "client/spatial.h"
 #include "layout/horizontal.h"
 #include "layout/vertical.h"
 
@@ -894,6 +1074,7 @@ void toggleoverlay(const Arg *arg) {
 			&selmon->sel->scene->node,
 			layers[selmon->sel->isfloating ? LyrFloat : LyrTile]);
 	}
+	scene_generation++;
 	setborder_color(selmon->sel);
 }
 
@@ -905,11 +1086,11 @@ void minized(const Arg *arg) {
 
 void restore_minized(const Arg *arg) {
 	Client *c;
-	if (selmon && selmon->sel && selmon->sel->is_in_scratchpad &&
-		selmon->sel->is_scratchpad_show) {
+	if (selmon && selmon->sel && selmon->sel->cold->is_in_scratchpad &&
+		selmon->sel->cold->is_scratchpad_show) {
 		selmon->sel->isminied = 0;
-		selmon->sel->is_scratchpad_show = 0;
-		selmon->sel->is_in_scratchpad = 0;
+		selmon->sel->cold->is_scratchpad_show = 0;
+		selmon->sel->cold->is_in_scratchpad = 0;
 		selmon->sel->isnamedscratchpad = 0;
 		setborder_color(selmon->sel);
 		return;
@@ -918,8 +1099,8 @@ void restore_minized(const Arg *arg) {
 	wl_list_for_each(c, &clients, link) {
 		if (c->isminied) {
 			show_hide_client(c);
-			c->is_scratchpad_show = 0;
-			c->is_in_scratchpad = 0;
+			c->cold->is_scratchpad_show = 0;
+			c->cold->is_in_scratchpad = 0;
 			c->isnamedscratchpad = 0;
 			setborder_color(c);
 			break;
@@ -928,7 +1109,7 @@ void restore_minized(const Arg *arg) {
 }
 
 void show_scratchpad(Client *c) {
-	c->is_scratchpad_show = 1;
+	c->cold->is_scratchpad_show = 1;
 	if (c->isfullscreen || c->ismaxmizescreen) {
 		c->isfullscreen = 0; // 清除窗口全屏标志
 		c->ismaxmizescreen = 0;
@@ -938,11 +1119,11 @@ void show_scratchpad(Client *c) {
 	/* return if fullscreen */
 	if (!c->isfloating) {
 		setfloating(c, 1);
-		c->geom.width = c->scratchpad_width
-							? c->scratchpad_width
+		c->geom.width = c->cold->scratchpad_width
+							? c->cold->scratchpad_width
 							: c->mon->w.width * scratchpad_width_ratio;
-		c->geom.height = c->scratchpad_height
-							 ? c->scratchpad_height
+		c->geom.height = c->cold->scratchpad_height
+							 ? c->cold->scratchpad_height
 							 : c->mon->w.height * scratchpad_height_ratio;
 		// 重新计算居中的坐标
 		c->oldgeom = c->geom = c->animainit_geom = c->animation.current =
@@ -957,25 +1138,96 @@ void show_scratchpad(Client *c) {
 	setborder_color(c);
 }
 
-pid_t getparentprocess(pid_t p) {
+// 作废一项,pid留着,不打断开放寻址的探测链
+static void ppid_cache_drop(PpidCacheEntry *e) {
+	if (e->exit_source) {
+		wl_event_source_remove(e->exit_source);
+		e->exit_source = NULL;
+	}
+}
+
+static int ppid_cache_exited(int fd, uint32_t mask, void *data) {
+	ppid_cache_drop(data);
+	return 0;
+}
+
+void ppid_cache_clear(void) {
+	unsigned int i;
+
+	for (i = 0; i < PPID_CACHE_SIZE; i++) {
+		if (ppid_cache[i].pid)
+			ppid_cache_drop(&ppid_cache[i]);
+	}
+	memset(ppid_cache, 0, sizeof(ppid_cache));
+	ppid_cache_count = 0;
+}
+
+// pidfd在进程退出后变为可读
+static bool pidfd_alive(int pidfd) {
+	struct pollfd pfd = {.fd = pidfd, .events = POLLIN};
+
+	return pidfd >= 0 && poll(&pfd, 1, 0) == 0;
+}
+
+static pid_t read_parentprocess(pid_t p) {
+	char path[32], buf[512], *s;
 	unsigned int v = 0;
+	ssize_t n;
+	int fd;
 
-	FILE *f;
-	char buf[256];
-	snprintf(buf, sizeof(buf) - 1, "/proc/%u/stat", (unsigned)p);
+	if (proc_fd < 0 &&
+		(proc_fd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0)
+		return 0;
 
-	if (!(f = fopen(buf, "r")))
+	snprintf(path, sizeof(path), "%u/stat", (unsigned)p);
+	if ((fd = openat(proc_fd, path, O_RDONLY | O_CLOEXEC)) < 0)
+		return 0;
+	n = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (n <= 0)
 		return 0;
+	buf[n] = '\0';
 
-	// 检查fscanf返回值，确保成功读取了1个参数
-	if (fscanf(f, "%*u %*s %*c %u", &v) != 1) {
-		fclose(f);
+	// 进程名里可能有空格和括号,从最后一个')'后面开始解析
+	if (!(s = strrchr(buf, ')')) || sscanf(s + 1, " %*c %u", &v) != 1)
 		return 0;
+
+	return (pid_t)v;
+}
+
+pid_t getparentprocess(pid_t p) {
+	unsigned int i, mask = PPID_CACHE_SIZE - 1;
+	int pidfd;
+
+	for (i = (unsigned)p & mask; ppid_cache[i].pid; i = (i + 1) & mask) {
+		if (ppid_cache[i].pid != p)
+			continue;
+		if (ppid_cache[i].exit_source)
+			return ppid_cache[i].ppid;
+		// 进程已经退出或者pid被复用了,原地重新读
+		ppid_cache_count--;
+		break;
 	}
 
-	fclose(f);
+	// 最多用一半,保证探测链不会太长
+	if (!ppid_cache[i].pid && ppid_cache_count >= PPID_CACHE_SIZE / 2) {
+		ppid_cache_clear();
+		i = (unsigned)p & mask;
+	}
 
-	return (pid_t)v;
+	/* 先拿pidfd再读stat,读完进程还活着,说明读到的就是这个进程的.
+	 * wl_event_loop_add_fd会自己dup一份,这里的可以直接关掉 */
+	ppid_cache[i].pid = p;
+	pidfd = syscall(SYS_pidfd_open, p, 0);
+	ppid_cache[i].ppid = read_parentprocess(p);
+	if (pidfd_alive(pidfd))
+		ppid_cache[i].exit_source =
+			wl_event_loop_add_fd(event_loop, pidfd, WL_EVENT_READABLE,
+								 ppid_cache_exited, &ppid_cache[i]);
+	if (pidfd >= 0)
+		close(pidfd);
+	ppid_cache_count++;
+	return ppid_cache[i].ppid;
 }
 
 int isdescprocess(pid_t p, pid_t c) {
@@ -1008,13 +1260,14 @@ void swallow(Client *c, Client *w) {
 	c->isfullscreen = w->isfullscreen;
 	c->ismaxmizescreen = w->ismaxmizescreen;
 	c->isminied = w->isminied;
-	c->is_in_scratchpad = w->is_in_scratchpad;
-	c->is_scratchpad_show = w->is_scratchpad_show;
+	c->cold->is_in_scratchpad = w->cold->is_in_scratchpad;
+	c->cold->is_scratchpad_show = w->cold->is_scratchpad_show;
 	c->tags = w->tags;
 	c->geom = w->geom;
 	c->scroller_proportion = w->scroller_proportion;
 	wl_list_insert(&w->link, &c->link);
 	wl_list_insert(&w->flink, &c->flink);
+	client_attach_tagindex(c);
 
 	if (w->foreign_toplevel)
 		remove_foreign_topleve(w);
@@ -1034,17 +1287,17 @@ void swallow(Client *c, Client *w) {
 }
 
 bool switch_scratchpad_client_state(Client *c) {
-	if (c->is_in_scratchpad && c->is_scratchpad_show &&
+	if (c->cold->is_in_scratchpad && c->cold->is_scratchpad_show &&
 		(selmon->tagset[selmon->seltags] & c->tags) == 0) {
 		unsigned int target =
 			get_tags_first_tag(selmon->tagset[selmon->seltags]);
 		tag_client(&(Arg){.ui = target}, c);
 		return true;
-	} else if (c->is_in_scratchpad && c->is_scratchpad_show &&
+	} else if (c->cold->is_in_scratchpad && c->cold->is_scratchpad_show &&
 			   (selmon->tagset[selmon->seltags] & c->tags) != 0) {
 		set_minized(c);
 		return true;
-	} else if (c && c->is_in_scratchpad && !c->is_scratchpad_show) {
+	} else if (c && c->cold->is_in_scratchpad && !c->cold->is_scratchpad_show) {
 		show_scratchpad(c);
 		return true;
 	}
@@ -1094,13 +1347,13 @@ void apply_named_scratchpad(Client *target_client) {
 		if (c->mon != selmon) {
 			continue;
 		}
-		if (single_scratchpad && c->is_in_scratchpad && c->is_scratchpad_show &&
-			c != target_client) {
+		if (single_scratchpad && c->cold->is_in_scratchpad &&
+			c->cold->is_scratchpad_show && c != target_client) {
 			set_minized(c);
 		}
 	}
 
-	if (!target_client->is_in_scratchpad) {
+	if (!target_client->cold->is_in_scratchpad) {
 		set_minized(target_client);
 		switch_scratchpad_client_state(target_client);
 	} else
@@ -1121,8 +1374,8 @@ void toggle_named_scratchpad(const Arg *arg) {
 	}
 
 	target_client->isnamedscratchpad = 1;
-	target_client->scratchpad_width = arg->ui;
-	target_client->scratchpad_height = arg->ui2;
+	target_client->cold->scratchpad_width = arg->ui;
+	target_client->cold->scratchpad_height = arg->ui2;
 
 	apply_named_scratchpad(target_client);
 }
@@ -1178,10 +1431,10 @@ void gpureset(struct wl_listener *listener, void *data) {
 }
 
 void handlesig(int signo) {
-	if (signo == SIGCHLD)
+	if (signo == SIGCHLD) {
 		while (waitpid(-1, NULL, WNOHANG) > 0)
 			;
-	else if (signo == SIGINT || signo == SIGTERM)
+	} else if (signo == SIGINT || signo == SIGTERM)
 		quit(NULL);
 }
 
@@ -1286,8 +1539,11 @@ static void apply_rule_properties(Client *c, const ConfigWinRule *r) {
 	APPLY_INT_PROP(isglobal);
 	APPLY_INT_PROP(isoverlay);
 	APPLY_INT_PROP(isunglobal);
-	APPLY_INT_PROP(scratchpad_width);
-	APPLY_INT_PROP(scratchpad_height);
+	if (r->scratchpad_width >= 0)
+		c->cold->scratchpad_width = r->scratchpad_width;
+	if (r->scratchpad_height >= 0)
+		c->cold->scratchpad_height = r->scratchpad_height;
+	APPLY_INT_PROP(max_frame_rate);
 
 	APPLY_FLOAT_PROP(scroller_proportion);
 	APPLY_FLOAT_PROP(focused_opacity);
@@ -1335,6 +1591,7 @@ int applyrulesgeom(Client *c) {
 }
 
 void applyrules(Client *c) {
+	TRACE_SCOPE("applyrules");
 	/* rule matching */
 	const char *appid, *title;
 	unsigned int i, newtags = 0;
@@ -1412,6 +1669,7 @@ void applyrules(Client *c) {
 			swallow(c, p);
 			wl_list_remove(&p->link);
 			wl_list_remove(&p->flink);
+			client_detach_tagindex(p);
 			mon = p->mon;
 			newtags = p->tags;
 		}
@@ -1425,6 +1683,7 @@ void applyrules(Client *c) {
 
 	int fullscreen_state_backup = c->isfullscreen;
 	setmon(c, mon, newtags, !c->isopensilent);
+	client_update_tagindex(c); // setmon没有换显示器时不会更新索引
 
 	if (!c->isopensilent && c->mon &&
 		!(c->tags & (1 << (c->mon->pertag->curtag - 1)))) {
@@ -1469,137 +1728,201 @@ bool is_scroller_layout(Monitor *m) {
 	return false;
 }
 
-void // 17
-arrange(Monitor *m, bool want_animation) {
-	Client *c;
-
-	if (!m)
-		return;
-
-	if (!m->wlr_output->enabled)
+void arrange_client(Monitor *m, Client *c, bool want_animation) {
+	// 同时在多个标签上的窗口只处理一次
+	if (c->iskilling || c->mon != m || c->arrange_serial == arrange_serial)
 		return;
+	c->arrange_serial = arrange_serial;
 
-	m->visible_clients = 0;
-	m->visible_tiling_clients = 0;
-	wl_list_for_each(c, &clients, link) {
-		if (c->iskilling)
-			continue;
+	if (VISIBLEON(c, m)) {
 
-		if (c->mon == m && (c->isglobal || c->isunglobal)) {
-			c->tags = m->tagset[m->seltags];
-			if (selmon->sel == NULL)
-				focusclient(c, 0);
+		if (!client_is_unmanaged(c) && !client_should_ignore_focus(c)) {
+			m->visible_clients++;
 		}
 
-		if (c->mon == m) {
-			if (VISIBLEON(c, m)) {
-
-				if (!client_is_unmanaged(c) && !client_should_ignore_focus(c)) {
-					m->visible_clients++;
-				}
+		if (ISTILED(c)) {
+			m->visible_tiling_clients++;
+		}
 
-				if (ISTILED(c)) {
-					m->visible_tiling_clients++;
+		if (!c->is_clip_to_hide || !ISTILED(c) ||
+			!is_scroller_layout(c->mon)) {
+			c->is_clip_to_hide = false;
+			wlr_scene_node_set_enabled(&c->scene->node, true);
+			wlr_scene_node_set_enabled(&c->scene_surface->node, true);
+		}
+		client_set_suspended(c, false);
+		if (!c->animation.tag_from_rule && want_animation &&
+			m->pertag->prevtag != 0 && m->pertag->curtag != 0 &&
+			animations) {
+			c->animation.tagining = true;
+			if (m->pertag->curtag > m->pertag->prevtag) {
+				if (c->animation.running) {
+					c->animainit_geom.x = c->animation.current.x;
+					c->animainit_geom.y = c->animation.current.y;
+				} else {
+					c->animainit_geom.x =
+						tag_animation_direction == VERTICAL
+							? c->animation.current.x
+							: c->mon->m.x + c->mon->m.width;
+					c->animainit_geom.y =
+						tag_animation_direction == VERTICAL
+							? c->mon->m.y + c->mon->m.height
+							: c->animation.current.y;
 				}
 
-				if (!c->is_clip_to_hide || !ISTILED(c) ||
-					!is_scroller_layout(c->mon)) {
-					c->is_clip_to_hide = false;
-					wlr_scene_node_set_enabled(&c->scene->node, true);
-					wlr_scene_node_set_enabled(&c->scene_surface->node, true);
-				}
-				client_set_suspended(c, false);
-				if (!c->animation.tag_from_rule && want_animation &&
-					m->pertag->prevtag != 0 && m->pertag->curtag != 0 &&
-					animations) {
-					c->animation.tagining = true;
-					if (m->pertag->curtag > m->pertag->prevtag) {
-						if (c->animation.running) {
-							c->animainit_geom.x = c->animation.current.x;
-							c->animainit_geom.y = c->animation.current.y;
-						} else {
-							c->animainit_geom.x =
-								tag_animation_direction == VERTICAL
-									? c->animation.current.x
-									: c->mon->m.x + c->mon->m.width;
-							c->animainit_geom.y =
-								tag_animation_direction == VERTICAL
-									? c->mon->m.y + c->mon->m.height
-									: c->animation.current.y;
-						}
-
-					} else {
-						if (c->animation.running) {
-							c->animainit_geom.x = c->animation.current.x;
-							c->animainit_geom.y = c->animation.current.y;
-						} else {
-							c->animainit_geom.x =
-								tag_animation_direction == VERTICAL
-									? c->animation.current.x
-									: m->m.x - c->geom.width;
-							c->animainit_geom.y =
-								tag_animation_direction == VERTICAL
-									? m->m.y - c->geom.height
-									: c->animation.current.y;
-						}
-					}
-				} else {
+			} else {
+				if (c->animation.running) {
 					c->animainit_geom.x = c->animation.current.x;
 					c->animainit_geom.y = c->animation.current.y;
+				} else {
+					c->animainit_geom.x =
+						tag_animation_direction == VERTICAL
+							? c->animation.current.x
+							: m->m.x - c->geom.width;
+					c->animainit_geom.y =
+						tag_animation_direction == VERTICAL
+							? m->m.y - c->geom.height
+							: c->animation.current.y;
 				}
+			}
+		} else {
+			c->animainit_geom.x = c->animation.current.x;
+			c->animainit_geom.y = c->animation.current.y;
+		}
 
-				c->animation.tag_from_rule = false;
-				c->animation.tagouting = false;
-				c->animation.tagouted = false;
-				resize(c, c->geom, 0);
+		c->animation.tag_from_rule = false;
+		c->animation.tagouting = false;
+		c->animation.tagouted = false;
+		resize(c, c->geom, 0);
+
+	} else {
+		if ((c->tags & (1 << (m->pertag->prevtag - 1))) &&
+			m->pertag->prevtag != 0 && m->pertag->curtag != 0 &&
+			animations) {
+			c->animation.tagouting = true;
+			c->animation.tagining = false;
+			if (m->pertag->curtag > m->pertag->prevtag) {
+				c->pending = c->geom;
+				c->pending.x = tag_animation_direction == VERTICAL
+								   ? c->animation.current.x
+								   : c->mon->m.x - c->geom.width;
+				c->pending.y = tag_animation_direction == VERTICAL
+								   ? c->mon->m.y - c->geom.height
+								   : c->animation.current.y;
 
+				resize(c, c->geom, 0);
 			} else {
-				if ((c->tags & (1 << (m->pertag->prevtag - 1))) &&
-					m->pertag->prevtag != 0 && m->pertag->curtag != 0 &&
-					animations) {
-					c->animation.tagouting = true;
-					c->animation.tagining = false;
-					if (m->pertag->curtag > m->pertag->prevtag) {
-						c->pending = c->geom;
-						c->pending.x = tag_animation_direction == VERTICAL
-										   ? c->animation.current.x
-										   : c->mon->m.x - c->geom.width;
-						c->pending.y = tag_animation_direction == VERTICAL
-										   ? c->mon->m.y - c->geom.height
-										   : c->animation.current.y;
-
-						resize(c, c->geom, 0);
-					} else {
-						c->pending = c->geom;
-						c->pending.x = tag_animation_direction == VERTICAL
-										   ? c->animation.current.x
-										   : c->mon->m.x + c->mon->m.width;
-						c->pending.y = tag_animation_direction == VERTICAL
-										   ? c->mon->m.y + c->mon->m.height
-										   : c->animation.current.y;
-						resize(c, c->geom, 0);
-					}
-				} else {
-					wlr_scene_node_set_enabled(&c->scene->node, false);
-					client_set_suspended(c, true);
-				}
+				c->pending = c->geom;
+				c->pending.x = tag_animation_direction == VERTICAL
+								   ? c->animation.current.x
+								   : c->mon->m.x + c->mon->m.width;
+				c->pending.y = tag_animation_direction == VERTICAL
+								   ? c->mon->m.y + c->mon->m.height
+								   : c->animation.current.y;
+				resize(c, c->geom, 0);
 			}
+		} else {
+			wlr_scene_node_set_enabled(&c->scene->node, false);
+			client_set_suspended(c, true);
 		}
+	}
+
+	if (c->ismaxmizescreen && !c->animation.tagouted &&
+		!c->animation.tagouting && VISIBLEON(c, m)) {
+		reset_maxmizescreen_size(c);
+	}
+}
+
+void // 17
+arrange(Monitor *m, bool want_animation) {
+	TRACE_SCOPE("arrange");
+	Client *c;
+	TagLink *tl, *tmp;
+	unsigned int i, tagmask;
+
+	if (!m)
+		return;
+
+	if (!m->wlr_output->enabled)
+		return;
+
+	if (dispatch_batch_depth) {
+		m->arrange_pending = true;
+		m->arrange_pending_animation |= want_animation;
+		return;
+	}
 
-		if (c->mon == m && c->ismaxmizescreen && !c->animation.tagouted &&
-			!c->animation.tagouting && VISIBLEON(c, m)) {
-			reset_maxmizescreen_size(c);
+	swipe_track_abort(m);
+	m->arrange_pending = false;
+	m->arrange_pending_animation = false;
+	m->visible_clients = 0;
+	m->visible_tiling_clients = 0;
+	arrange_serial++;
+	spatial_index_invalidate();
+	scene_generation++;
+
+	// global窗口跟随显示器当前的标签
+	wl_list_for_each_safe(tl, tmp, &m->pertag->tag_clients[LENGTH(tags)],
+						  link) {
+		c = tl->c;
+		if (c->iskilling)
+			continue;
+		c->tags = m->tagset[m->seltags];
+		client_update_tagindex(c);
+		if (selmon->sel == NULL)
+			focusclient(c, 0);
+	}
+
+	// 只处理标签变动过的窗口,以及当前视图和上次视图上的窗口,
+	// 其他标签上的窗口在离开视图的时候就已经隐藏了
+	while (!wl_list_empty(&m->tag_changed_clients)) {
+		c = wl_container_of(m->tag_changed_clients.next, c, tag_changed_link);
+		wl_list_remove(&c->tag_changed_link);
+		wl_list_init(&c->tag_changed_link);
+		arrange_client(m, c, want_animation);
+	}
+
+	tagmask = m->tagset[m->seltags] | m->arranged_tagset;
+	if (m->pertag->prevtag)
+		tagmask |= 1 << (m->pertag->prevtag - 1);
+	m->arranged_tagset = m->tagset[m->seltags];
+
+	for (i = 0; i < LENGTH(tags); i++) {
+		if (!(tagmask & (1 << i)))
+			continue;
+		wl_list_for_each_safe(tl, tmp, &m->pertag->tag_clients[i], link) {
+			arrange_client(m, tl->c, want_animation);
 		}
 	}
 
 	if (m->isoverview) {
+		TRACE_BEGIN(overviewlayout.name);
 		overviewlayout.arrange(m);
+		TRACE_END(overviewlayout.name);
 	} else if (m && m->pertag->ltidxs[m->pertag->curtag]->arrange) {
+		TRACE_BEGIN(m->pertag->ltidxs[m->pertag->curtag]->name);
 		m->pertag->ltidxs[m->pertag->curtag]->arrange(m);
+		TRACE_END(m->pertag->ltidxs[m->pertag->curtag]->name);
 	}
 
-	motionnotify(0, NULL, 0, 0, 0, 0);
-	checkidleinhibitor(NULL);
+	schedule_pointer_refocus();
+	schedule_idle_inhibit_check();
+}
+
+/* 批量执行dispatch时每个显示器只在最后arrange一次,
+ * 焦点刷新和状态发送本身已经合并到空闲回调里 */
+void dispatch_batch_begin(void) { dispatch_batch_depth++; }
+
+void dispatch_batch_end(void) {
+	Monitor *m;
+
+	if (!dispatch_batch_depth || --dispatch_batch_depth)
+		return;
+
+	wl_list_for_each(m, &mons, link) {
+		if (m->arrange_pending)
+			arrange(m, m->arrange_pending_animation);
+	}
 }
 
 void arrangelayer(Monitor *m, struct wl_list *list, struct wlr_box *usable_area,
@@ -1642,6 +1965,11 @@ Client *center_select(Monitor *m) {
 	return target_c;
 }
 
+static bool window_snap_candidate(Client *tc, Client *c) {
+	return tc->isfloating && !tc->iskilling && client_surface(tc)->mapped &&
+		   VISIBLEON(tc, c->mon);
+}
+
 void apply_window_snap(Client *c) {
 	int snap_up = 99999, snap_down = 99999, snap_left = 99999,
 		snap_right = 99999;
@@ -1653,8 +1981,8 @@ void apply_window_snap(Client *c) {
 		snap_right_mon = 0;
 
 	unsigned int cbw = !render_border || c->fake_no_border ? borderpx : 0;
-	unsigned int tcbw;
-	unsigned int cx, cy, cw, ch, tcx, tcy, tcw, tch;
+	unsigned int tcbw, i;
+	unsigned int cx, cy, cw, ch;
 	cx = c->geom.x + cbw;
 	cy = c->geom.y + cbw;
 	cw = c->geom.width - 2 * cbw;
@@ -1667,34 +1995,60 @@ void apply_window_snap(Client *c) {
 	if (!c->isfloating || !enable_floating_snap)
 		return;
 
-	wl_list_for_each(tc, &clients, link) {
-		if (tc && tc->isfloating && !tc->iskilling &&
-			client_surface(tc)->mapped && VISIBLEON(tc, c->mon)) {
-
-			tcbw = !render_border || tc->fake_no_border ? borderpx : 0;
-			tcx = tc->geom.x + tcbw;
-			tcy = tc->geom.y + tcbw;
-			tcw = tc->geom.width - 2 * tcbw;
-			tch = tc->geom.height - 2 * tcbw;
-
-			snap_left_temp = cx - tcx - tcw;
-			snap_right_temp = tcx - cx - cw;
-			snap_up_temp = cy - tcy - tch;
-			snap_down_temp = tcy - cy - ch;
-
-			if (snap_left_temp < snap_left && snap_left_temp >= 0) {
-				snap_left = snap_left_temp;
-			}
-			if (snap_right_temp < snap_right && snap_right_temp >= 0) {
-				snap_right = snap_right_temp;
-			}
-			if (snap_up_temp < snap_up && snap_up_temp >= 0) {
-				snap_up = snap_up_temp;
-			}
-			if (snap_down_temp < snap_down && snap_down_temp >= 0) {
-				snap_down = snap_down_temp;
-			}
-		}
+	// 只有小于snap_distance的距离会生效,所以只需要查询这个范围内的边,
+	// 边框可能不算在内,范围要再放宽borderpx
+	spatial_index_update();
+	for (i = spatial_lower_bound(spatial_index.right,
+								 (int)cx - snap_distance + 1, INT_MIN);
+		 i < spatial_index.len &&
+		 spatial_index.right[i].key <= (int)cx + (int)borderpx;
+		 i++) {
+		tc = spatial_index.right[i].c;
+		if (!window_snap_candidate(tc, c))
+			continue;
+		tcbw = !render_border || tc->fake_no_border ? borderpx : 0;
+		snap_left_temp = cx - (tc->geom.x + tc->geom.width - tcbw);
+		if (snap_left_temp < snap_left && snap_left_temp >= 0)
+			snap_left = snap_left_temp;
+	}
+	for (i = spatial_lower_bound(spatial_index.left,
+								 (int)(cx + cw) - (int)borderpx, INT_MIN);
+		 i < spatial_index.len &&
+		 spatial_index.left[i].key < (int)(cx + cw) + snap_distance;
+		 i++) {
+		tc = spatial_index.left[i].c;
+		if (!window_snap_candidate(tc, c))
+			continue;
+		tcbw = !render_border || tc->fake_no_border ? borderpx : 0;
+		snap_right_temp = tc->geom.x + tcbw - cx - cw;
+		if (snap_right_temp < snap_right && snap_right_temp >= 0)
+			snap_right = snap_right_temp;
+	}
+	for (i = spatial_lower_bound(spatial_index.bottom,
+								 (int)cy - snap_distance + 1, INT_MIN);
+		 i < spatial_index.len &&
+		 spatial_index.bottom[i].key <= (int)cy + (int)borderpx;
+		 i++) {
+		tc = spatial_index.bottom[i].c;
+		if (!window_snap_candidate(tc, c))
+			continue;
+		tcbw = !render_border || tc->fake_no_border ? borderpx : 0;
+		snap_up_temp = cy - (tc->geom.y + tc->geom.height - tcbw);
+		if (snap_up_temp < snap_up && snap_up_temp >= 0)
+			snap_up = snap_up_temp;
+	}
+	for (i = spatial_lower_bound(spatial_index.top,
+								 (int)(cy + ch) - (int)borderpx, INT_MIN);
+		 i < spatial_index.len &&
+		 spatial_index.top[i].key < (int)(cy + ch) + snap_distance;
+		 i++) {
+		tc = spatial_index.top[i].c;
+		if (!window_snap_candidate(tc, c))
+			continue;
+		tcbw = !render_border || tc->fake_no_border ? borderpx : 0;
+		snap_down_temp = tc->geom.y + tcbw - cy - ch;
+		if (snap_down_temp < snap_down && snap_down_temp >= 0)
+			snap_down = snap_down_temp;
 	}
 
 	snap_left_mon = cx - c->mon->m.x;
@@ -1747,167 +2101,8 @@ void apply_window_snap(Client *c) {
 
 Client *find_client_by_direction(Client *tc, const Arg *arg, bool findfloating,
 								 bool align) {
-	Client *c;
-	Client **tempClients = NULL; // 初始化为 NULL
-	int last = -1;
-
-	// 第一次遍历，计算客户端数量
-	wl_list_for_each(c, &clients, link) {
-		if (c && (findfloating || !c->isfloating) && !c->isunglobal &&
-			(focus_cross_monitor || c->mon == selmon) &&
-			(c->tags & c->mon->tagset[c->mon->seltags])) {
-			last++;
-		}
-	}
-
-	if (last < 0) {
-		return NULL; // 没有符合条件的客户端
-	}
-
-	// 动态分配内存
-	tempClients = malloc((last + 1) * sizeof(Client *));
-	if (!tempClients) {
-		// 处理内存分配失败的情况
-		return NULL;
-	}
-
-	// 第二次遍历，填充 tempClients
-	last = -1;
-	wl_list_for_each(c, &clients, link) {
-		if (c && (findfloating || !c->isfloating) && !c->isunglobal &&
-			(focus_cross_monitor || c->mon == selmon) &&
-			(c->tags & c->mon->tagset[c->mon->seltags])) {
-			last++;
-			tempClients[last] = c;
-		}
-	}
-
-	int sel_x = tc->geom.x;
-	int sel_y = tc->geom.y;
-	long long int distance = LLONG_MAX;
-	Client *tempFocusClients = NULL;
-
-	switch (arg->i) {
-	case UP:
-		for (int _i = 0; _i <= last; _i++) {
-			if (tempClients[_i]->geom.y < sel_y &&
-				tempClients[_i]->geom.x == sel_x) {
-				int dis_x = tempClients[_i]->geom.x - sel_x;
-				int dis_y = tempClients[_i]->geom.y - sel_y;
-				long long int tmp_distance =
-					dis_x * dis_x + dis_y * dis_y; // 计算距离
-				if (tmp_distance < distance) {
-					distance = tmp_distance;
-					tempFocusClients = tempClients[_i];
-				}
-			}
-		}
-		if (!tempFocusClients && !align) {
-			for (int _i = 0; _i <= last; _i++) {
-				if (tempClients[_i]->geom.y < sel_y) {
-					int dis_x = tempClients[_i]->geom.x - sel_x;
-					int dis_y = tempClients[_i]->geom.y - sel_y;
-					long long int tmp_distance =
-						dis_x * dis_x + dis_y * dis_y; // 计算距离
-					if (tmp_distance < distance) {
-						distance = tmp_distance;
-						tempFocusClients = tempClients[_i];
-					}
-				}
-			}
-		}
-		break;
-	case DOWN:
-		for (int _i = 0; _i <= last; _i++) {
-			if (tempClients[_i]->geom.y > sel_y &&
-				tempClients[_i]->geom.x == sel_x) {
-				int dis_x = tempClients[_i]->geom.x - sel_x;
-				int dis_y = tempClients[_i]->geom.y - sel_y;
-				long long int tmp_distance =
-					dis_x * dis_x + dis_y * dis_y; // 计算距离
-				if (tmp_distance < distance) {
-					distance = tmp_distance;
-					tempFocusClients = tempClients[_i];
-				}
-			}
-		}
-		if (!tempFocusClients && !align) {
-			for (int _i = 0; _i <= last; _i++) {
-				if (tempClients[_i]->geom.y > sel_y) {
-					int dis_x = tempClients[_i]->geom.x - sel_x;
-					int dis_y = tempClients[_i]->geom.y - sel_y;
-					long long int tmp_distance =
-						dis_x * dis_x + dis_y * dis_y; // 计算距离
-					if (tmp_distance < distance) {
-						distance = tmp_distance;
-						tempFocusClients = tempClients[_i];
-					}
-				}
-			}
-		}
-		break;
-	case LEFT:
-		for (int _i = 0; _i <= last; _i++) {
-			if (tempClients[_i]->geom.x < sel_x &&
-				tempClients[_i]->geom.y == sel_y) {
-				int dis_x = tempClients[_i]->geom.x - sel_x;
-				int dis_y = tempClients[_i]->geom.y - sel_y;
-				long long int tmp_distance =
-					dis_x * dis_x + dis_y * dis_y; // 计算距离
-				if (tmp_distance < distance) {
-					distance = tmp_distance;
-					tempFocusClients = tempClients[_i];
-				}
-			}
-		}
-		if (!tempFocusClients && !align) {
-			for (int _i = 0; _i <= last; _i++) {
-				if (tempClients[_i]->geom.x < sel_x) {
-					int dis_x = tempClients[_i]->geom.x - sel_x;
-					int dis_y = tempClients[_i]->geom.y - sel_y;
-					long long int tmp_distance =
-						dis_x * dis_x + dis_y * dis_y; // 计算距离
-					if (tmp_distance < distance) {
-						distance = tmp_distance;
-						tempFocusClients = tempClients[_i];
-					}
-				}
-			}
-		}
-		break;
-	case RIGHT:
-		for (int _i = 0; _i <= last; _i++) {
-			if (tempClients[_i]->geom.x > sel_x &&
-				tempClients[_i]->geom.y == sel_y) {
-				int dis_x = tempClients[_i]->geom.x - sel_x;
-				int dis_y = tempClients[_i]->geom.y - sel_y;
-				long long int tmp_distance =
-					dis_x * dis_x + dis_y * dis_y; // 计算距离
-				if (tmp_distance < distance) {
-					distance = tmp_distance;
-					tempFocusClients = tempClients[_i];
-				}
-			}
-		}
-		if (!tempFocusClients && !align) {
-			for (int _i = 0; _i <= last; _i++) {
-				if (tempClients[_i]->geom.x > sel_x) {
-					int dis_x = tempClients[_i]->geom.x - sel_x;
-					int dis_y = tempClients[_i]->geom.y - sel_y;
-					long long int tmp_distance =
-						dis_x * dis_x + dis_y * dis_y; // 计算距离
-					if (tmp_distance < distance) {
-						distance = tmp_distance;
-						tempFocusClients = tempClients[_i];
-					}
-				}
-			}
-		}
-		break;
-	}
-
-	free(tempClients); // 释放内存
-	return tempFocusClients;
+	return spatial_find_direction(tc->geom.x, tc->geom.y, arg->i, findfloating,
+								  align);
 }
 
 Client *direction_select(const Arg *arg) {
@@ -1953,6 +2148,8 @@ void arrangelayers(Monitor *m) {
 	if (!m->wlr_output->enabled)
 		return;
 
+	scene_generation++;
+
 	/* Arrange exclusive surfaces from top->bottom */
 	for (i = 3; i >= 0; i--)
 		arrangelayer(m, &m->layers[i], &usable_area, 1);
@@ -2011,8 +2208,11 @@ axisnotify(struct wl_listener *listener, void *data) {
 	struct wlr_keyboard *keyboard;
 	unsigned int mods;
 	AxisBinding *a;
-	int ji;
+	unsigned int ji;
 	unsigned int adir;
+	input_record(InputAxis, event->orientation,
+				 event->source | event->relative_direction << 8, event->delta,
+				 event->delta_discrete, 0, 0);
 	// IDLE_NOTIFY_ACTIVITY;
 	handlecursoractivity();
 	wlr_idle_notifier_v1_notify_activity(idle_notifier, seat);
@@ -2021,29 +2221,31 @@ axisnotify(struct wl_listener *listener, void *data) {
 	// 获取当前按键的mask,比如alt+super或者alt+ctrl
 	mods = keyboard ? wlr_keyboard_get_modifiers(keyboard) : 0;
 
+	// 抬起手指的axis stop没有方向,正在滚轮平移时直接交给平移处理
+	if (event->delta == 0 && swipe_track.mode == SwipeTrackScroller &&
+		swipe_track.axis) {
+		scroller_axis_pan(event);
+		return;
+	}
+
 	if (event->orientation == WL_POINTER_AXIS_VERTICAL_SCROLL)
 		adir = event->delta > 0 ? AxisDown : AxisUp;
 	else
 		adir = event->delta > 0 ? AxisRight : AxisLeft;
 
-	for (ji = 0; ji < config.axis_bindings_count; ji++) {
-		if (config.axis_bindings_count < 1)
-			break;
-		a = &config.axis_bindings[ji];
-		if (CLEANMASK(mods) == CLEANMASK(a->mod) && // 按键一致
-			adir == a->dir && a->func) { // 滚轮方向判断一致且处理函数存在
-			if (event->time_msec - axis_apply_time > axis_bind_apply_timeout ||
-				axis_apply_dir * event->delta < 0) {
-				a->func(&a->arg);
-				axis_apply_time = event->time_msec;
-				axis_apply_dir = event->delta > 0 ? 1 : -1;
-				return; // 如果成功匹配就不把这个滚轮事件传送给客户端了
-			} else {
-				axis_apply_dir = event->delta > 0 ? 1 : -1;
-				axis_apply_time = event->time_msec;
-				return;
-			}
+	// 按滚轮方向和修饰键直接查表,没有绑定就直接发给客户端
+	if ((ji = config.axis_binding_table[adir][BINDING_MODS_INDEX(mods)])) {
+		a = &config.axis_bindings[ji - 1];
+		if (a->func == scroller_pan) {
+			scroller_axis_pan(event);
+			return;
 		}
+		if (event->time_msec - axis_apply_time > axis_bind_apply_timeout ||
+			axis_apply_dir * event->delta < 0)
+			a->func(&a->arg);
+		axis_apply_time = event->time_msec;
+		axis_apply_dir = event->delta > 0 ? 1 : -1;
+		return; // 如果成功匹配就不把这个滚轮事件传送给客户端了
 	}
 
 	/* TODO: allow usage of scroll whell for mousebindings, it can be
@@ -2064,7 +2266,7 @@ int ongesture(struct wlr_pointer_swipe_end_event *event) {
 	unsigned int adx = (int)round(fabs(swipe_dx));
 	unsigned int ady = (int)round(fabs(swipe_dy));
 	int handled = 0;
-	int ji;
+	unsigned int ji, serial;
 
 	if (event->cancelled) {
 		return handled;
@@ -2084,22 +2286,28 @@ int ongesture(struct wlr_pointer_swipe_end_event *event) {
 	keyboard = wlr_seat_get_keyboard(seat);
 	mods = keyboard ? wlr_keyboard_get_modifiers(keyboard) : 0;
 
-	for (ji = 0; ji < config.gesture_bindings_count; ji++) {
-		if (config.gesture_bindings_count < 1)
+	if (swipe_fingers >= GESTURE_BINDING_FINGERS)
+		return handled;
+
+	serial = bindings_serial;
+	for (ji = config.gesture_binding_table[swipe_fingers][motion]
+										  [BINDING_MODS_INDEX(mods)];
+		 ji; ji = config.gesture_binding_next[ji - 1]) {
+		g = &config.gesture_bindings[ji - 1];
+		g->func(&g->arg);
+		handled = 1;
+		// 绑定的函数重载了配置,链表已经不在了
+		if (serial != bindings_serial)
 			break;
-		g = &config.gesture_bindings[ji];
-		if (CLEANMASK(mods) == CLEANMASK(g->mod) &&
-			swipe_fingers == g->fingers_count && motion == g->motion &&
-			g->func) {
-			g->func(&g->arg);
-			handled = 1;
-		}
 	}
 	return handled;
 }
 
 void swipe_begin(struct wl_listener *listener, void *data) {
 	struct wlr_pointer_swipe_begin_event *event = data;
+	input_record(InputSwipeBegin, 0, event->fingers, 0, 0, 0, 0);
+	swipe_track_begin(event->fingers, event->time_msec);
+	swipe_client_cancelled = false;
 
 	// Forward swipe begin event to client
 	wlr_pointer_gestures_v1_send_swipe_begin(pointer_gestures, seat,
@@ -2108,11 +2316,25 @@ void swipe_begin(struct wl_listener *listener, void *data) {
 
 void swipe_update(struct wl_listener *listener, void *data) {
 	struct wlr_pointer_swipe_update_event *event = data;
+	input_record(InputSwipeUpdate, 0, event->fingers, event->dx, event->dy, 0,
+				 0);
 
 	swipe_fingers = event->fingers;
 	// Accumulate swipe distance
 	swipe_dx += event->dx;
 	swipe_dy += event->dy;
+	swipe_track_update(event->dx, event->dy, event->time_msec);
+
+	// 合成器接管了这次滑动,给客户端发取消,之后的事件都不再转发
+	if (swipe_client_cancelled)
+		return;
+	if (swipe_track.mode == SwipeTrackTag ||
+		swipe_track.mode == SwipeTrackScroller) {
+		swipe_client_cancelled = true;
+		wlr_pointer_gestures_v1_send_swipe_end(pointer_gestures, seat,
+											   event->time_msec, true);
+		return;
+	}
 
 	// Forward swipe update event to client
 	wlr_pointer_gestures_v1_send_swipe_update(
@@ -2121,9 +2343,15 @@ void swipe_update(struct wl_listener *listener, void *data) {
 
 void swipe_end(struct wl_listener *listener, void *data) {
 	struct wlr_pointer_swipe_end_event *event = data;
-	ongesture(event);
+	input_record(InputSwipeEnd, event->cancelled, 0, 0, 0, 0, 0);
+	if (!swipe_track_end(event->cancelled, event->time_msec))
+		ongesture(event);
 	swipe_dx = 0;
 	swipe_dy = 0;
+	if (swipe_client_cancelled) {
+		swipe_client_cancelled = false;
+		return;
+	}
 	// Forward swipe end event to client
 	wlr_pointer_gestures_v1_send_swipe_end(pointer_gestures, seat,
 										   event->time_msec, event->cancelled);
@@ -2131,6 +2359,7 @@ void swipe_end(struct wl_listener *listener, void *data) {
 
 void pinch_begin(struct wl_listener *listener, void *data) {
 	struct wlr_pointer_pinch_begin_event *event = data;
+	input_record(InputPinchBegin, 0, event->fingers, 0, 0, 0, 0);
 
 	// Forward pinch begin event to client
 	wlr_pointer_gestures_v1_send_pinch_begin(pointer_gestures, seat,
@@ -2139,6 +2368,8 @@ void pinch_begin(struct wl_listener *listener, void *data) {
 
 void pinch_update(struct wl_listener *listener, void *data) {
 	struct wlr_pointer_pinch_update_event *event = data;
+	input_record(InputPinchUpdate, 0, event->fingers, event->dx, event->dy,
+				 event->scale, event->rotation);
 
 	// Forward pinch update event to client
 	wlr_pointer_gestures_v1_send_pinch_update(
@@ -2148,6 +2379,7 @@ void pinch_update(struct wl_listener *listener, void *data) {
 
 void pinch_end(struct wl_listener *listener, void *data) {
 	struct wlr_pointer_pinch_end_event *event = data;
+	input_record(InputPinchEnd, event->cancelled, 0, 0, 0, 0, 0);
 
 	// Forward pinch end event to client
 	wlr_pointer_gestures_v1_send_pinch_end(pointer_gestures, seat,
@@ -2156,6 +2388,7 @@ void pinch_end(struct wl_listener *listener, void *data) {
 
 void hold_begin(struct wl_listener *listener, void *data) {
 	struct wlr_pointer_hold_begin_event *event = data;
+	input_record(InputHoldBegin, 0, event->fingers, 0, 0, 0, 0);
 
 	// Forward hold begin event to client
 	wlr_pointer_gestures_v1_send_hold_begin(pointer_gestures, seat,
@@ -2164,6 +2397,7 @@ void hold_begin(struct wl_listener *listener, void *data) {
 
 void hold_end(struct wl_listener *listener, void *data) {
 	struct wlr_pointer_hold_end_event *event = data;
+	input_record(InputHoldEnd, event->cancelled, 0, 0, 0, 0, 0);
 
 	// Forward hold end event to client
 	wlr_pointer_gestures_v1_send_hold_end(pointer_gestures, seat,
@@ -2209,11 +2443,12 @@ buttonpress(struct wl_listener *listener, void *data) {
 	LayerSurface *l;
 	struct wlr_surface *surface;
 	Client *tmpc;
-	int ji;
+	unsigned int ji;
 	const MouseBinding *b;
 	struct wlr_surface *old_pointer_focus_surface =
 		seat->pointer_state.focused_surface;
 
+	input_record(InputButton, event->state, event->button, 0, 0, 0, 0);
 	handlecursoractivity();
 	wlr_idle_notifier_v1_notify_activity(idle_notifier, seat);
 
@@ -2246,21 +2481,17 @@ buttonpress(struct wl_listener *listener, void *data) {
 
 		keyboard = wlr_seat_get_keyboard(seat);
 		mods = keyboard ? wlr_keyboard_get_modifiers(keyboard) : 0;
-		for (ji = 0; ji < config.mouse_bindings_count; ji++) {
-			if (config.mouse_bindings_count < 1)
-				break;
-			b = &config.mouse_bindings[ji];
-			if (CLEANMASK(mods) == CLEANMASK(b->mod) &&
-				event->button == b->button && b->func &&
-				(selmon->isoverview == 1 || b->button == BTN_MIDDLE) && c) {
-				b->func(&b->arg);
-				return;
-			} else if (CLEANMASK(mods) == CLEANMASK(b->mod) &&
-					   event->button == b->button && b->func &&
-					   CLEANMASK(b->mod) != 0) {
-				b->func(&b->arg);
-				return;
-			}
+		if (event->button < BTN_LEFT || event->button > BTN_TASK)
+			break;
+		ji = config.mouse_binding_table[event->button - BTN_LEFT]
+									   [BINDING_MODS_INDEX(mods)];
+		if (!ji)
+			break;
+		b = &config.mouse_bindings[ji - 1];
+		if (((selmon->isoverview == 1 || b->button == BTN_MIDDLE) && c) ||
+			CLEANMASK(b->mod) != 0) {
+			b->func(&b->arg);
+			return;
 		}
 		break;
 	case WL_POINTER_BUTTON_STATE_RELEASED:
@@ -2284,6 +2515,9 @@ buttonpress(struct wl_listener *listener, void *data) {
 			selmon->sel = grabc;
 			tmpc = grabc;
 			grabc = NULL;
+			// 拖动过程中x11窗口没有同步位置,这里补发一次
+			client_set_size(tmpc, tmpc->geom.width - 2 * tmpc->bw,
+							tmpc->geom.height - 2 * tmpc->bw);
 			if (tmpc->drag_to_tile && drag_tile_to_tile) {
 				place_drag_tile_client(tmpc);
 			} else {
@@ -2352,11 +2586,13 @@ void cleanuplisteners(void) {
 	wl_list_remove(&new_virtual_keyboard.link);
 	wl_list_remove(&new_virtual_pointer.link);
 	wl_list_remove(&new_pointer_constraint.link);
+	wl_list_remove(&pointer_focus_change.link);
 	wl_list_remove(&new_output.link);
 	wl_list_remove(&new_xdg_toplevel.link);
 	wl_list_remove(&new_xdg_decoration.link);
 	wl_list_remove(&new_xdg_popup.link);
 	wl_list_remove(&new_layer_surface.link);
+	wl_list_remove(&new_surface.link);
 	wl_list_remove(&output_mgr_apply.link);
 	wl_list_remove(&output_mgr_test.link);
 	wl_list_remove(&output_power_mgr_set_mode.link);
@@ -2376,6 +2612,9 @@ void cleanuplisteners(void) {
 
 void cleanup(void) {
 	cleanuplisteners();
+	launcher_finish();
+	ipc_finish();
+	state_finish();
 #ifdef XWAYLAND
 	wlr_xwayland_destroy(xwayland);
 	xwayland = NULL;
@@ -2388,7 +2627,9 @@ void cleanup(void) {
 	}
 	wlr_xcursor_manager_destroy(cursor_mgr);
 
+	input_record_finish();
 	destroykeyboardgroup(&kb_group->destroy, NULL);
+	keymap_cache_finish();
 
 	dwl_im_relay_finish(dwl_input_method_relay);
 
@@ -2406,10 +2647,7 @@ void // 17
 cleanupkeyboard(struct wl_listener *listener, void *data) {
 	Keyboard *kb = wl_container_of(listener, kb, destroy);
 
-	wl_event_source_remove(kb->key_repeat_source);
 	wl_list_remove(&kb->link);
-	wl_list_remove(&kb->modifiers.link);
-	wl_list_remove(&kb->key.link);
 	wl_list_remove(&kb->destroy.link);
 	free(kb);
 }
@@ -2419,6 +2657,9 @@ void cleanupmon(struct wl_listener *listener, void *data) {
 	LayerSurface *l, *tmp;
 	unsigned int i;
 
+	if (swipe_track.m == m)
+		swipe_track.mode = SwipeTrackNone;
+
 	/* m->layers[i] are intentionally not unlinked */
 	for (i = 0; i < LENGTH(m->layers); i++) {
 		wl_list_for_each_safe(l, tmp, &m->layers[i], link)
@@ -2427,6 +2668,7 @@ void cleanupmon(struct wl_listener *listener, void *data) {
 
 	wl_list_remove(&m->destroy.link);
 	wl_list_remove(&m->frame.link);
+	wl_list_remove(&m->present.link);
 	wl_list_remove(&m->link);
 	wl_list_remove(&m->request_state.link);
 	if (m->lock_surface)
@@ -2465,11 +2707,12 @@ void closemon(Monitor *m) {
 			if (selmon == NULL) {
 				remove_foreign_topleve(c);
 				c->mon = NULL;
+				client_update_tagindex(c);
 			} else {
 				client_change_mon(c, selmon);
 			}
 			// record the oldmonname which is used to restore
-			if (c->oldmonname[0] == '\0') {
+			if (c->cold->oldmonname[0] == '\0') {
 				client_update_oldmonname_record(c, m);
 			}
 		}
@@ -2503,6 +2746,7 @@ void maplayersurfacenotify(struct wl_listener *listener, void *data) {
 	int ji;
 
 	l->mapped = 1;
+	scene_generation++;
 
 	if (!l->mon)
 		return;
@@ -2661,11 +2905,14 @@ void commitlayersurfacenotify(struct wl_listener *listener, void *data) {
 }
 
 void commitnotify(struct wl_listener *listener, void *data) {
+	TRACE_SCOPE("commitnotify");
 	Client *c = wl_container_of(listener, c, commit);
 
 	if (!c->surface.xdg->initialized)
 		return;
 
+	client_stats_commit(c);
+
 	if (c->surface.xdg->initial_commit) {
 		// xdg client will first enter this before mapnotify
 		applyrules(c);
@@ -2751,6 +2998,53 @@ void commitpopup(struct wl_listener *listener, void *data) {
 	free(listener);
 }
 
+static uint32_t surface_input_layout_hash(struct wlr_surface *surface) {
+	struct wlr_subsurface *subsurface;
+	struct wlr_xdg_popup *popup;
+	uint32_t h = 2166136261u;
+
+	// popup重新定位时大小可能不变,位置也算进来
+	if ((popup = wlr_xdg_popup_try_from_wlr_surface(surface))) {
+		h = (h ^ (uint32_t)popup->current.geometry.x) * 16777619u;
+		h = (h ^ (uint32_t)popup->current.geometry.y) * 16777619u;
+	}
+
+	wl_list_for_each(subsurface, &surface->current.subsurfaces_below,
+					 current.link) {
+		h = (h ^ (uint32_t)(uintptr_t)subsurface) * 16777619u;
+		h = (h ^ (uint32_t)subsurface->current.x) * 16777619u;
+		h = (h ^ (uint32_t)subsurface->current.y) * 16777619u;
+	}
+	h = (h ^ 1u) * 16777619u; /* 区分在父表面下面还是上面 */
+	wl_list_for_each(subsurface, &surface->current.subsurfaces_above,
+					 current.link) {
+		h = (h ^ (uint32_t)(uintptr_t)subsurface) * 16777619u;
+		h = (h ^ (uint32_t)subsurface->current.x) * 16777619u;
+		h = (h ^ (uint32_t)subsurface->current.y) * 16777619u;
+	}
+	return h;
+}
+
+void commitsurface(struct wl_listener *listener, void *data) {
+	SurfaceWatch *watch = wl_container_of(listener, watch, commit);
+	struct wlr_surface *surface = watch->surface;
+	uint32_t subsurfaces = surface_input_layout_hash(surface);
+
+	/* 只有大小,偏移,输入区域或者子表面变化才影响命中结果,
+	 * 只换了buffer内容(视频,动画,光标闪烁)的提交不让命中缓存失效 */
+	if (surface->current.width == watch->width &&
+		surface->current.height == watch->height &&
+		subsurfaces == watch->subsurfaces &&
+		!(surface->current.committed &
+		  (WLR_SURFACE_STATE_INPUT_REGION | WLR_SURFACE_STATE_OFFSET)))
+		return;
+
+	watch->width = surface->current.width;
+	watch->height = surface->current.height;
+	watch->subsurfaces = subsurfaces;
+	scene_generation++;
+}
+
 void createdecoration(struct wl_listener *listener, void *data) {
 	struct wlr_xdg_toplevel_decoration_v1 *deco = data;
 	Client *c = deco->toplevel->base->data;
@@ -2767,32 +3061,79 @@ void createidleinhibitor(struct wl_listener *listener, void *data) {
 	struct wlr_idle_inhibitor_v1 *idle_inhibitor = data;
 	LISTEN_STATIC(&idle_inhibitor->events.destroy, destroyidleinhibitor);
 
-	checkidleinhibitor(NULL);
+	schedule_idle_inhibit_check();
 }
 
 void createkeyboard(struct wlr_keyboard *keyboard) {
+	struct wlr_keyboard *group_keyboard = &kb_group->wlr_group->keyboard;
+	Keyboard *kb = ecalloc(1, sizeof(*kb));
+
+	kb->wlr_keyboard = keyboard;
+	wl_list_insert(&keyboards, &kb->link);
+	LISTEN(&keyboard->base.events.destroy, &kb->destroy, cleanupkeyboard);
 
 	/* Set the keymap to match the group keymap */
-	wlr_keyboard_set_keymap(keyboard, kb_group->wlr_group->keyboard.keymap);
+	wlr_keyboard_set_keymap(keyboard, group_keyboard->keymap);
 
-	wlr_keyboard_notify_modifiers(keyboard, 0, 0, locked_mods, 0);
+	// 新键盘沿用当前的布局,不然加入组时会把组切回第一个布局
+	wlr_keyboard_notify_modifiers(keyboard, 0, 0, locked_mods,
+								  group_keyboard->modifiers.group);
 
 	/* Add the new keyboard to the group */
 	wlr_keyboard_group_add_keyboard(kb_group->wlr_group, keyboard);
 }
 
+// 按当前的xkb_rules取keymap,缓存里没有才编译,返回的引用归缓存所有
+struct xkb_keymap *compile_keymap(void) {
+	char names[sizeof(keymap_cache[0].names)];
+	struct xkb_keymap *keymap;
+	unsigned int i;
+
+	snprintf(names, sizeof(names), "%s\n%s\n%s\n%s\n%s", xkb_rules.rules,
+			 xkb_rules.model, xkb_rules.layout, xkb_rules.variant,
+			 xkb_rules.options);
+	for (i = 0; i < KEYMAP_CACHE_SIZE; i++) {
+		if (keymap_cache[i].keymap && strcmp(keymap_cache[i].names, names) == 0)
+			return keymap_cache[i].keymap;
+	}
+
+	if (!keymap_context &&
+		!(keymap_context = xkb_context_new(XKB_CONTEXT_NO_FLAGS)))
+		return NULL;
+	if (!(keymap = xkb_keymap_new_from_names(keymap_context, &xkb_rules,
+											 XKB_KEYMAP_COMPILE_NO_FLAGS)))
+		return NULL;
+
+	i = keymap_cache_next++ % KEYMAP_CACHE_SIZE;
+	if (keymap_cache[i].keymap)
+		xkb_keymap_unref(keymap_cache[i].keymap);
+	memcpy(keymap_cache[i].names, names, sizeof(names));
+	keymap_cache[i].keymap = keymap;
+	return keymap;
+}
+
+void keymap_cache_finish(void) {
+	unsigned int i;
+
+	for (i = 0; i < KEYMAP_CACHE_SIZE; i++) {
+		if (keymap_cache[i].keymap)
+			xkb_keymap_unref(keymap_cache[i].keymap);
+		keymap_cache[i].keymap = NULL;
+	}
+	if (keymap_context)
+		xkb_context_unref(keymap_context);
+	keymap_context = NULL;
+}
+
 KeyboardGroup *createkeyboardgroup(void) {
 	KeyboardGroup *group = ecalloc(1, sizeof(*group));
-	struct xkb_context *context;
 	struct xkb_keymap *keymap;
 
 	group->wlr_group = wlr_keyboard_group_create();
 	group->wlr_group->data = group;
 
 	/* Prepare an XKB keymap and assign it to the keyboard group. */
-	context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
-	if (!(keymap = xkb_keymap_new_from_names(context, &xkb_rules,
-											 XKB_KEYMAP_COMPILE_NO_FLAGS)))
+	if (!(keymap = compile_keymap()))
 		die("failed to compile keymap");
 
 	wlr_keyboard_set_keymap(&group->wlr_group->keyboard, keymap);
@@ -2815,9 +3156,6 @@ KeyboardGroup *createkeyboardgroup(void) {
 		wlr_keyboard_notify_modifiers(&group->wlr_group->keyboard, 0, 0,
 									  locked_mods, 0);
 
-	xkb_keymap_unref(keymap);
-	xkb_context_unref(context);
-
 	wlr_keyboard_set_repeat_info(&group->wlr_group->keyboard, repeat_rate,
 								 repeat_delay);
 
@@ -2826,8 +3164,14 @@ KeyboardGroup *createkeyboardgroup(void) {
 	LISTEN(&group->wlr_group->keyboard.events.modifiers, &group->modifiers,
 		   keypressmod);
 
-	group->key_repeat_source =
-		wl_event_loop_add_timer(event_loop, keyrepeat, group);
+	group->key_repeat_fd =
+		timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (group->key_repeat_fd < 0)
+		wlr_log_errno(WLR_ERROR, "key repeat: timerfd_create");
+	else
+		group->key_repeat_source =
+			wl_event_loop_add_fd(event_loop, group->key_repeat_fd,
+								 WL_EVENT_READABLE, keyrepeat, group);
 
 	/* A seat can only have one keyboard, but this is a limitation of the
 	 * Wayland protocol - not wlroots. We assign all connected keyboards to the
@@ -2966,6 +3310,7 @@ void createmon(struct wl_listener *listener, void *data) {
 
 	/* Set up event listeners */
 	LISTEN(&wlr_output->events.frame, &m->frame, rendermon);
+	LISTEN(&wlr_output->events.present, &m->present, presentmon);
 	LISTEN(&wlr_output->events.destroy, &m->destroy, cleanupmon);
 	LISTEN(&wlr_output->events.request_state, &m->request_state,
 		   requestmonstate);
@@ -2977,8 +3322,10 @@ void createmon(struct wl_listener *listener, void *data) {
 	wl_list_insert(&mons, &m->link);
 	m->pertag = calloc(1, sizeof(Pertag));
 	m->pertag->curtag = m->pertag->prevtag = 1;
+	wl_list_init(&m->tag_changed_clients);
 
 	for (i = 0; i <= LENGTH(tags); i++) {
+		wl_list_init(&m->pertag->tag_clients[i]);
 		m->pertag->nmasters[i] = m->nmaster;
 		m->pertag->mfacts[i] = m->mfact;
 		m->pertag->smfacts[i] = default_smfact;
@@ -3040,6 +3387,7 @@ createnotify(struct wl_listener *listener, void *data) {
 
 	/* Allocate a Client for this surface */
 	c = toplevel->base->data = ecalloc(1, sizeof(*c));
+	c->cold = ecalloc(1, sizeof(*c->cold));
 	c->surface.xdg = toplevel->base;
 	c->bw = borderpx;
 
@@ -3111,12 +3459,40 @@ void createpointer(struct wlr_pointer *pointer) {
 	wlr_cursor_attach_input_device(cursor, &pointer->base);
 }
 
+void createsurface(struct wl_listener *listener, void *data) {
+	struct wlr_surface *surface = data;
+	SurfaceWatch *watch = ecalloc(1, sizeof(*watch));
+
+	watch->surface = surface;
+	LISTEN(&surface->events.commit, &watch->commit, commitsurface);
+	LISTEN(&surface->events.destroy, &watch->destroy, destroysurface);
+}
+
+/* surface销毁时constraint会先跟着销毁并移除addon,这里只是兜底 */
+static void pointerconstraint_addon_destroy(struct wlr_addon *addon) {
+	wlr_addon_finish(addon);
+	wl_list_init(&addon->link);
+}
+
+static const struct wlr_addon_interface pointer_constraint_addon_impl = {
+	.name = "maomao_pointer_constraint",
+	.destroy = pointerconstraint_addon_destroy,
+};
+
 void createpointerconstraint(struct wl_listener *listener, void *data) {
 	PointerConstraint *pointer_constraint =
 		ecalloc(1, sizeof(*pointer_constraint));
 	pointer_constraint->constraint = data;
+	/* 同一个surface和seat只允许有一个constraint,wlroots会拒绝重复的 */
+	wlr_addon_init(&pointer_constraint->addon,
+				   &pointer_constraint->constraint->surface->addons,
+				   pointer_constraints, &pointer_constraint_addon_impl);
 	LISTEN(&pointer_constraint->constraint->events.destroy,
 		   &pointer_constraint->destroy, destroypointerconstraint);
+
+	if (pointer_constraint->constraint->surface ==
+		seat->pointer_state.focused_surface)
+		pointerconstraintupdate();
 }
 
 void createpopup(struct wl_listener *listener, void *data) {
@@ -3127,14 +3503,17 @@ void createpopup(struct wl_listener *listener, void *data) {
 }
 
 void cursorconstrain(struct wlr_pointer_constraint_v1 *constraint) {
-	if (active_constraint == constraint)
-		return;
+	struct wlr_pointer_constraint_v1 *old = active_constraint;
 
-	if (active_constraint)
-		wlr_pointer_constraint_v1_send_deactivated(active_constraint);
+	if (old == constraint)
+		return;
 
+	/* 先换掉active_constraint,oneshot的constraint在deactivated里会被销毁 */
 	active_constraint = constraint;
-	wlr_pointer_constraint_v1_send_activated(constraint);
+	if (old)
+		wlr_pointer_constraint_v1_send_deactivated(old);
+	if (constraint)
+		wlr_pointer_constraint_v1_send_activated(constraint);
 }
 
 void cursorframe(struct wl_listener *listener, void *data) {
@@ -3143,6 +3522,7 @@ void cursorframe(struct wl_listener *listener, void *data) {
 	 * multiple events together. For instance, two axis events may happen at the
 	 * same time, in which case a frame event won't be sent in between. */
 	/* Notify the client with pointer focus of the frame event. */
+	input_record(InputFrame, 0, 0, 0, 0, 0, 0);
 	wlr_seat_pointer_notify_frame(seat);
 }
 
@@ -3171,8 +3551,9 @@ void destroydragicon(struct wl_listener *listener, void *data) {
 
 void destroyidleinhibitor(struct wl_listener *listener, void *data) {
 	/* `data` is the wlr_surface of the idle inhibitor being destroyed,
-	 * at this point the idle inhibitor is still in the list of the manager */
-	checkidleinhibitor(wlr_surface_get_root_surface(data));
+	 * at this point the idle inhibitor is still in the list of the manager,
+	 * but it will be gone by the time the deferred check runs */
+	schedule_idle_inhibit_check();
 	wl_list_remove(&listener->link);
 	free(listener);
 }
@@ -3196,6 +3577,7 @@ void destroylock(SessionLock *lock, int unlock) {
 		goto destroy;
 
 	wlr_scene_node_set_enabled(&locked_bg->node, false);
+	scene_generation++;
 
 	focusclient(focustop(selmon), 0);
 	motionnotify(0, NULL, 0, 0, 0, 0);
@@ -3235,6 +3617,7 @@ void // 0.7 custom
 destroynotify(struct wl_listener *listener, void *data) {
 	/* Called when the xdg_toplevel is destroyed. */
 	Client *c = wl_container_of(listener, c, destroy);
+	launch_stats_client_gone(c);
 	wl_list_remove(&c->destroy.link);
 	wl_list_remove(&c->set_title.link);
 	wl_list_remove(&c->fullscreen.link);
@@ -3254,6 +3637,7 @@ destroynotify(struct wl_listener *listener, void *data) {
 		wl_list_remove(&c->map.link);
 		wl_list_remove(&c->unmap.link);
 	}
+	free(c->cold);
 	free(c);
 }
 
@@ -3266,10 +3650,21 @@ void destroypointerconstraint(struct wl_listener *listener, void *data) {
 		active_constraint = NULL;
 	}
 
+	if (!wl_list_empty(&pointer_constraint->addon.link))
+		wlr_addon_finish(&pointer_constraint->addon);
 	wl_list_remove(&pointer_constraint->destroy.link);
 	free(pointer_constraint);
 }
 
+void destroysurface(struct wl_listener *listener, void *data) {
+	SurfaceWatch *watch = wl_container_of(listener, watch, destroy);
+
+	wl_list_remove(&watch->commit.link);
+	wl_list_remove(&watch->destroy.link);
+	free(watch);
+	scene_generation++;
+}
+
 void destroysessionlock(struct wl_listener *listener, void *data) {
 	SessionLock *lock = wl_container_of(listener, lock, destroy);
 	destroylock(lock, 0);
@@ -3277,7 +3672,10 @@ void destroysessionlock(struct wl_listener *listener, void *data) {
 
 void destroykeyboardgroup(struct wl_listener *listener, void *data) {
 	KeyboardGroup *group = wl_container_of(listener, group, destroy);
-	wl_event_source_remove(group->key_repeat_source);
+	if (group->key_repeat_source)
+		wl_event_source_remove(group->key_repeat_source);
+	if (group->key_repeat_fd >= 0)
+		close(group->key_repeat_fd);
 	wl_list_remove(&group->key.link);
 	wl_list_remove(&group->modifiers.link);
 	wl_list_remove(&group->destroy.link);
@@ -3323,8 +3721,10 @@ void focusclient(Client *c, int lift) {
 	}
 
 	/* Raise client in stacking order if requested */
-	if (c && lift)
+	if (c && lift) {
 		wlr_scene_node_raise_to_top(&c->scene->node); // 将视图提升到顶层
+		scene_generation++;
+	}
 
 	if (c && client_surface(c) == old_keyboard_focus_surface && selmon &&
 		selmon->sel)
@@ -3357,7 +3757,7 @@ void focusclient(Client *c, int lift) {
 		wl_list_insert(&fstack, &c->flink);
 
 		// change border color
-		c->isurgent = 0;
+		client_set_urgent(c, 0);
 		setborder_color(c);
 	}
 
@@ -3406,7 +3806,7 @@ void focusclient(Client *c, int lift) {
 	}
 
 	/* Change cursor surface */
-	motionnotify(0, NULL, 0, 0, 0, 0);
+	schedule_pointer_refocus();
 
 	/* Have a client, so focus its top-level wlr_surface */
 	client_notify_enter(client_surface(c), wlr_seat_get_keyboard(seat));
@@ -3481,6 +3881,11 @@ focusstack(const Arg *arg) {
 Client * // 0.5
 focustop(Monitor *m) {
 	Client *c;
+
+	// 当前视图没有窗口就不用遍历整个焦点栈
+	if (!m || !tagindex_has_clients(m, m->tagset[m->seltags]))
+		return NULL;
+
 	wl_list_for_each(c, &fstack, flink) {
 		if (c->iskilling || c->isunglobal)
 			continue;
@@ -3577,24 +3982,68 @@ void inputdevice(struct wl_listener *listener, void *data) {
 	wlr_seat_set_capabilities(seat, caps);
 }
 
-int keyrepeat(void *data) {
+/* 快捷键重复用绝对时间的timerfd:第一次在按下后delay毫秒,
+ * 之后每隔1/rate秒(纳秒精度)到期,不会因为整数毫秒和处理耗时累积漂移.
+ * 卡顿时内核累计到期次数,补发的次数有上限 */
+void key_repeat_start(KeyboardGroup *group) {
+	struct wlr_keyboard *keyboard = &group->wlr_group->keyboard;
+	struct itimerspec spec = {0};
+	uint64_t start, period;
+
+	if (group->key_repeat_fd < 0 || keyboard->repeat_info.delay <= 0 ||
+		keyboard->repeat_info.rate <= 0) {
+		key_repeat_stop(group);
+		return;
+	}
+
+	start = monotonic_ns() + (uint64_t)keyboard->repeat_info.delay * 1000000;
+	period = 1000000000ull / keyboard->repeat_info.rate;
+	spec.it_value.tv_sec = start / 1000000000;
+	spec.it_value.tv_nsec = start % 1000000000;
+	spec.it_interval.tv_sec = period / 1000000000;
+	spec.it_interval.tv_nsec = period % 1000000000;
+	timerfd_settime(group->key_repeat_fd, TFD_TIMER_ABSTIME, &spec, NULL);
+}
+
+void key_repeat_stop(KeyboardGroup *group) {
+	struct itimerspec spec = {0};
+
+	if (!group->nrepeat)
+		return;
+	group->nrepeat = 0;
+	if (group->key_repeat_fd >= 0)
+		timerfd_settime(group->key_repeat_fd, 0, &spec, NULL);
+}
+
+int keyrepeat(int fd, uint32_t mask, void *data) {
 	KeyboardGroup *group = data;
-	int i;
-	if (!group->nsyms || group->wlr_group->keyboard.repeat_info.rate <= 0)
-		return 0;
+	const KeyBinding *k;
+	uint64_t expirations;
+	int i, n;
 
-	wl_event_source_timer_update(
-		group->key_repeat_source,
-		1000 / group->wlr_group->keyboard.repeat_info.rate);
+	if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+		return 0;
 
-	for (i = 0; i < group->nsyms; i++)
-		keybinding(group->mods, group->keysyms[i], group->keycode);
+	n = MIN(expirations, KEY_REPEAT_CATCHUP_MAX);
+	while (n-- > 0) {
+		for (i = 0; i < group->nrepeat; i++) {
+			// 配置重载过,缓存的下标已经失效
+			if (group->repeat_serial != bindings_serial) {
+				key_repeat_stop(group);
+				return 0;
+			}
+			k = &config.key_bindings[group->repeat_bindings[i]];
+			k->func(&k->arg);
+		}
+	}
 
 	return 0;
 }
 
+/* group不为NULL时把匹配到的绑定记下来给按住重复用 */
 int // 17
-keybinding(unsigned int mods, xkb_keysym_t sym, unsigned int keycode) {
+keybinding(KeyboardGroup *group, unsigned int mods, xkb_keysym_t sym,
+		   unsigned int keycode) {
 	/*
 	 * Here we handle compositor keybindings. This is when the compositor is
 	 * processing keys, rather than passing them on to the client for its own
@@ -3614,6 +4063,8 @@ keybinding(unsigned int mods, xkb_keysym_t sym, unsigned int keycode) {
 			 (k->keysymcode.type == KEY_TYPE_CODE &&
 			  keycode == k->keysymcode.keycode)) &&
 			k->func) {
+			if (group && group->nrepeat < KEY_REPEAT_BINDINGS_MAX)
+				group->repeat_bindings[group->nrepeat++] = ji;
 			k->func(&k->arg);
 			handled = 1;
 		}
@@ -3680,11 +4131,13 @@ done:
 }
 
 void keypress(struct wl_listener *listener, void *data) {
+	TRACE_SCOPE("keypress");
 	int i;
 	/* This event is raised when a key is pressed or released. */
 	KeyboardGroup *group = wl_container_of(listener, group, key);
 	struct wlr_keyboard_key_event *event = data;
 
+	input_record(InputKey, event->state, event->keycode, 0, 0, 0, 0);
 	struct wlr_surface *last_surface = seat->keyboard_state.focused_surface;
 	struct wlr_xdg_surface *xdg_surface =
 		last_surface ? wlr_xdg_surface_try_from_wlr_surface(last_surface)
@@ -3722,23 +4175,17 @@ void keypress(struct wl_listener *listener, void *data) {
 
 	/* On _press_ if there is no active screen locker,
 	 * attempt to process a compositor keybinding. */
+	key_repeat_stop(group);
 	if (!locked && event->state == WL_KEYBOARD_KEY_STATE_PRESSED) {
+		group->repeat_serial = bindings_serial;
 		for (i = 0; i < nsyms; i++)
-			handled = keybinding(mods, syms[i], keycode) || handled;
+			handled = keybinding(group, mods, syms[i], keycode) || handled;
 	}
 
-	if (handled && group->wlr_group->keyboard.repeat_info.delay > 0) {
-		group->mods = mods;
-		group->keysyms = syms;
-		group->keycode = keycode;
-		group->nsyms = nsyms;
-		wl_event_source_timer_update(
-			group->key_repeat_source,
-			group->wlr_group->keyboard.repeat_info.delay);
-	} else {
-		group->nsyms = 0;
-		wl_event_source_timer_update(group->key_repeat_source, 0);
-	}
+	if (handled)
+		key_repeat_start(group);
+	else
+		key_repeat_stop(group);
 
 	if (handled)
 		return;
@@ -3823,6 +4270,7 @@ void locksession(struct wl_listener *listener, void *data) {
 	struct wlr_session_lock_v1 *session_lock = data;
 	SessionLock *lock;
 	wlr_scene_node_set_enabled(&locked_bg->node, true);
+	scene_generation++;
 	if (cur_lock) {
 		wlr_session_lock_v1_destroy(session_lock);
 		return;
@@ -3879,9 +4327,9 @@ void init_client_properties(Client *c) {
 	c->isminied = 0;
 	c->isoverlay = 0;
 	c->isunglobal = 0;
-	c->is_in_scratchpad = 0;
+	c->cold->is_in_scratchpad = 0;
 	c->isnamedscratchpad = 0;
-	c->is_scratchpad_show = 0;
+	c->cold->is_scratchpad_show = 0;
 	c->need_float_size_reduce = 0;
 	c->is_clip_to_hide = 0;
 	c->is_restoring_from_ov = 0;
@@ -3896,15 +4344,18 @@ void init_client_properties(Client *c) {
 	c->nofadein = 0;
 	c->nofadeout = 0;
 	c->no_force_center = 0;
-	c->scratchpad_width = 0;
-	c->scratchpad_height = 0;
+	c->cold->scratchpad_width = 0;
+	c->cold->scratchpad_height = 0;
 }
 
 void // old fix to 0.5
 mapnotify(struct wl_listener *listener, void *data) {
+	TRACE_SCOPE("mapnotify");
 	/* Called when the surface is mapped, or ready to display on-screen. */
 	Client *p = NULL;
 	Client *c = wl_container_of(listener, c, map);
+	launch_stats_map_start(c);
+	scene_generation++;
 	/* Create scene tree for this client and its border */
 	c->scene = client_surface(c)->data = wlr_scene_tree_create(layers[LyrTile]);
 	wlr_scene_node_set_enabled(&c->scene->node, c->type != XDGShell);
@@ -3985,6 +4436,7 @@ mapnotify(struct wl_listener *listener, void *data) {
 	} else
 		wl_list_insert(clients.prev, &c->link); // 尾部入栈
 	wl_list_insert(&fstack, &c->flink);
+	client_attach_tagindex(c);
 
 	/* Set initial monitor, tags, floating status, and focus:
 	 * we always consider floating, clients that have parent and thus
@@ -4001,6 +4453,7 @@ mapnotify(struct wl_listener *listener, void *data) {
 	c->is_pending_open_animation = true;
 	resize(c, c->geom, 0);
 	printstatus();
+	launch_stats_map_done(c);
 }
 
 void // 0.5 custom
@@ -4036,11 +4489,12 @@ void set_minized(Client *c) {
 
 	c->isglobal = 0;
 	c->oldtags = c->mon->tagset[c->mon->seltags];
-	c->mini_restore_tag = c->tags;
+	c->cold->mini_restore_tag = c->tags;
 	c->tags = 0;
+	client_update_tagindex(c);
 	c->isminied = 1;
-	c->is_in_scratchpad = 1;
-	c->is_scratchpad_show = 0;
+	c->cold->is_in_scratchpad = 1;
+	c->cold->is_scratchpad_show = 0;
 	focusclient(focustop(selmon), 1);
 	arrange(c->mon, false);
 	wlr_foreign_toplevel_handle_v1_set_activated(c->foreign_toplevel, false);
@@ -4082,6 +4536,8 @@ void motionabsolute(struct wl_listener *listener, void *data) {
 	struct wlr_pointer_motion_absolute_event *event = data;
 	double lx, ly, dx, dy;
 
+	input_record(InputMotionAbsolute, 0, 0, event->x, event->y, 0, 0);
+
 	if (!event->time_msec) /* this is 0 with virtual pointers */
 		wlr_cursor_warp_absolute(cursor, &event->pointer->base, event->x,
 								 event->y);
@@ -4095,11 +4551,11 @@ void motionabsolute(struct wl_listener *listener, void *data) {
 
 void motionnotify(unsigned int time, struct wlr_input_device *device, double dx,
 				  double dy, double dx_unaccel, double dy_unaccel) {
+	TRACE_SCOPE("motionnotify");
 	double sx = 0, sy = 0, sx_confined, sy_confined;
 	Client *c = NULL, *w = NULL;
 	LayerSurface *l = NULL;
 	struct wlr_surface *surface = NULL;
-	struct wlr_pointer_constraint_v1 *constraint;
 	bool should_lock = false;
 
 	/* Find the client under the pointer and send the event along. */
@@ -4121,9 +4577,7 @@ void motionnotify(unsigned int time, struct wlr_input_device *device, double dx,
 			relative_pointer_mgr, seat, (uint64_t)time * 1000, dx, dy,
 			dx_unaccel, dy_unaccel);
 
-		wl_list_for_each(constraint, &pointer_constraints->constraints, link)
-			cursorconstrain(constraint);
-
+		/* active_constraint在指针焦点变化和constraint创建销毁时更新 */
 		if (active_constraint && cursor_mode != CurResize &&
 			cursor_mode != CurMove) {
 			toplevel_from_wlr_surface(active_constraint->surface, &c, NULL);
@@ -4221,6 +4675,8 @@ void motionrelative(struct wl_listener *listener, void *data) {
 	 * special configuration applied for the specific input device which
 	 * generated the event. You can pass NULL for the device if you want to move
 	 * the cursor around without any input. */
+	input_record(InputMotion, 0, 0, event->delta_x, event->delta_y,
+				 event->unaccel_dx, event->unaccel_dy);
 	motionnotify(event->time_msec, &event->pointer->base, event->delta_x,
 				 event->delta_y, event->unaccel_dx, event->unaccel_dy);
 	toggle_hotarea(cursor->x, cursor->y);
@@ -4324,9 +4780,34 @@ outputmgrapplyortest(struct wlr_output_configuration_v1 *config, int test) {
 	updatemons(NULL, NULL);
 }
 
-void outputmgrtest(struct wl_listener *listener, void *data) {
-	struct wlr_output_configuration_v1 *config = data;
-	outputmgrapplyortest(config, 1);
+void outputmgrtest(struct wl_listener *listener, void *data) {
+	struct wlr_output_configuration_v1 *config = data;
+	outputmgrapplyortest(config, 1);
+}
+
+struct wlr_pointer_constraint_v1 *
+pointerconstraint_for_surface(struct wlr_surface *surface) {
+	struct wlr_addon *addon;
+	PointerConstraint *pointer_constraint;
+
+	if (!surface)
+		return NULL;
+	addon = wlr_addon_find(&surface->addons, pointer_constraints,
+						   &pointer_constraint_addon_impl);
+	if (!addon)
+		return NULL;
+	pointer_constraint = wl_container_of(addon, pointer_constraint, addon);
+	return pointer_constraint->constraint;
+}
+
+// 只激活指针焦点surface上的constraint,失去焦点的会被deactivate
+void pointerconstraintupdate(void) {
+	cursorconstrain(
+		pointerconstraint_for_surface(seat->pointer_state.focused_surface));
+}
+
+void pointerfocuschange(struct wl_listener *listener, void *data) {
+	pointerconstraintupdate();
 }
 
 void pointerfocus(Client *c, struct wlr_surface *surface, double sx, double sy,
@@ -4357,13 +4838,24 @@ void pointerfocus(Client *c, struct wlr_surface *surface, double sx, double sy,
 
 void // 17
 printstatus(void) {
+	// 合并到事件循环空闲时再发送,一次循环里多次调用只发一次
+	if (!status_source)
+		status_source = wl_event_loop_add_idle(event_loop, flush_status, NULL);
+}
+
+void flush_status(void *data) {
 	Monitor *m = NULL;
+
+	status_source = NULL;
 	wl_list_for_each(m, &mons, link) {
 		if (!m->wlr_output->enabled) {
 			continue;
 		}
 		dwl_ipc_output_printstatus(m); // 更新waybar上tag的状态 这里很关键
 	}
+	if (state_publish())
+		ipc_notify_state();
+	ipc_broadcast();
 }
 
 void powermgrsetmode(struct wl_listener *listener, void *data) {
@@ -4400,15 +4892,18 @@ void client_set_opacity(Client *c, double opacity) {
 }
 
 void rendermon(struct wl_listener *listener, void *data) {
+	TRACE_SCOPE("rendermon");
 	Monitor *m = wl_container_of(listener, m, frame);
-	Client *c, *tmp;
+	Client *c;
 	struct wlr_output_state pending = {0};
 	LayerSurface *l, *tmpl;
+	FadeoutSnapshot *s, *tmps;
 	int i;
 	struct wl_list *layer_list;
 
 	struct timespec now;
 	bool need_more_frames = false;
+	uint64_t frame_start = monotonic_ns(), tick_done;
 
 	for (i = 0; i < LENGTH(m->layers); i++) {
 		layer_list = &m->layers[i];
@@ -4423,19 +4918,26 @@ void rendermon(struct wl_listener *listener, void *data) {
 		need_more_frames = client_draw_frame(c) || need_more_frames;
 	}
 
-	wl_list_for_each_safe(c, tmp, &fadeout_clients, fadeout_link) {
-		need_more_frames = client_draw_fadeout_frame(c) || need_more_frames;
+	wl_list_for_each_safe(s, tmps, &fadeout_clients, link) {
+		need_more_frames = client_draw_fadeout_frame(s) || need_more_frames;
 	}
 
-	wl_list_for_each_safe(l, tmpl, &fadeout_layers, fadeout_link) {
-		need_more_frames = layer_draw_fadeout_frame(l) || need_more_frames;
+	wl_list_for_each_safe(s, tmps, &fadeout_layers, link) {
+		need_more_frames = layer_draw_fadeout_frame(s) || need_more_frames;
 	}
 
+	tick_done = monotonic_ns();
+	TRACE_BEGIN("wlr_scene_output_commit");
 	wlr_scene_output_commit(m->scene_output, NULL);
+	TRACE_END("wlr_scene_output_commit");
 
 	// Send frame done notification
 	clock_gettime(CLOCK_MONOTONIC, &now);
-	wlr_scene_output_send_frame_done(m->scene_output, &now);
+	send_frame_done(m, &now);
+	frame_stats_commit(m, frame_start, tick_done,
+					   (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec,
+					   need_more_frames);
+	input_replay_commit((uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec);
 
 	// // Clean up pending state
 	wlr_output_state_finish(&pending);
@@ -4469,7 +4971,7 @@ void setborder_color(Client *c) {
 		client_set_border_color(c, urgentcolor);
 		return;
 	}
-	if (c->is_in_scratchpad && selmon && c == selmon->sel) {
+	if (c->cold->is_in_scratchpad && selmon && c == selmon->sel) {
 		client_set_border_color(c, scratchpadcolor);
 	} else if (c->isglobal && selmon && c == selmon->sel) {
 		client_set_border_color(c, globalcolor);
@@ -4545,6 +5047,8 @@ run(char *startup_cmd) {
 	if (!socket)
 		die("startup: display_add_socket_auto");
 	setenv("WAYLAND_DISPLAY", socket, 1);
+	ipc_init();
+	state_init();
 
 	/* Start the backend. This will enumerate outputs and inputs, become the DRM
 	 * master, etc */
@@ -4692,8 +5196,8 @@ setfloating(Client *c, int floating) {
 		c->need_float_size_reduce = 0;
 	} else {
 		c->need_float_size_reduce = 1;
-		c->is_scratchpad_show = 0;
-		c->is_in_scratchpad = 0;
+		c->cold->is_scratchpad_show = 0;
+		c->cold->is_in_scratchpad = 0;
 		c->isnamedscratchpad = 0;
 		// 让当前tag中的全屏窗口退出全屏参与平铺
 		wl_list_for_each(fc, &clients, link) if (fc && fc != c &&
@@ -4828,254 +5332,94 @@ setlayout(const Arg *arg) {
 	}
 }
 
-char *get_layout_abbr(const char *full_name) {
-	// 1. 尝试在映射表中查找
-	for (int i = 0; layout_mappings[i].full_name != NULL; i++) {
-		if (strcmp(full_name, layout_mappings[i].full_name) == 0) {
-			return strdup(layout_mappings[i].abbr);
-		}
-	}
-
-	// 2. 尝试从名称中提取并转换为小写
-	const char *open = strrchr(full_name, '(');
-	const char *close = strrchr(full_name, ')');
-	if (open && close && close > open) {
-		unsigned int len = close - open - 1;
-		if (len > 0 && len <= 4) {
-			char *abbr = malloc(len + 1);
-			if (abbr) {
-				// 提取并转换为小写
-				for (unsigned int j = 0; j < len; j++) {
-					abbr[j] = tolower(open[j + 1]);
-				}
-				abbr[len] = '\0';
-				return abbr;
-			}
-		}
-	}
-
-	// 3. 提取前2-3个字母并转换为小写
-	char *abbr = malloc(4);
-	if (abbr) {
-		unsigned int j = 0;
-		for (unsigned int i = 0; full_name[i] != '\0' && j < 3; i++) {
-			if (isalpha(full_name[i])) {
-				abbr[j++] = tolower(full_name[i]);
-			}
-		}
-		abbr[j] = '\0';
-
-		// 确保至少2个字符
-		if (j >= 2)
-			return abbr;
-		free(abbr);
-	}
+/* 把kb_group切到keymap里的第group个布局.只改xkb状态,不重新编译keymap.
+ * 成员键盘的modifiers变化时keyboard group会把成员的状态同步给组,
+ * 所以改第一个成员键盘,由组同步给其他成员和组本身 */
+void set_keyboard_layout_group(xkb_layout_index_t group) {
+	struct wlr_keyboard *keyboard = &kb_group->wlr_group->keyboard;
+	struct wlr_keyboard *target = keyboard;
+	Keyboard *kb;
 
-	// 4. 回退方案：使用首字母小写
-	char *fallback = malloc(3);
-	if (fallback) {
-		fallback[0] = tolower(full_name[0]);
-		fallback[1] = full_name[1] ? tolower(full_name[1]) : '\0';
-		fallback[2] = '\0';
-		return fallback;
+	if (!wl_list_empty(&keyboards)) {
+		kb = wl_container_of(keyboards.next, kb, link);
+		target = kb->wlr_keyboard;
 	}
+	wlr_keyboard_notify_modifiers(target, target->modifiers.depressed,
+								  target->modifiers.latched,
+								  target->modifiers.locked, group);
+	if (target != keyboard)
+		wlr_keyboard_notify_modifiers(keyboard, keyboard->modifiers.depressed,
+									  keyboard->modifiers.latched,
+									  keyboard->modifiers.locked, group);
 
-	// 5. 最终回退：返回 "xx"
-	return strdup("xx");
+	wlr_seat_set_keyboard(seat, keyboard);
+	wlr_seat_keyboard_notify_modifiers(seat, &keyboard->modifiers);
 }
 
+// 重载配置时调用,xkb规则没变就什么都不做,变了换keymap并保留当前布局
 void reset_keyboard_layout(void) {
+	struct wlr_keyboard *keyboard, *target;
+	struct xkb_keymap *keymap;
+	xkb_layout_index_t current, num_layouts;
+	Keyboard *kb;
+
 	if (!kb_group || !kb_group->wlr_group || !seat) {
 		wlr_log(WLR_ERROR, "Invalid keyboard group or seat");
 		return;
 	}
 
-	struct wlr_keyboard *keyboard = &kb_group->wlr_group->keyboard;
-	if (!keyboard || !keyboard->keymap) {
-		wlr_log(WLR_ERROR, "Invalid keyboard or keymap");
-		return;
-	}
-
-	// Get current layout
-	xkb_layout_index_t current = xkb_state_serialize_layout(
-		keyboard->xkb_state, XKB_STATE_LAYOUT_EFFECTIVE);
-	const int num_layouts = xkb_keymap_num_layouts(keyboard->keymap);
-	if (num_layouts < 1) {
-		wlr_log(WLR_INFO, "No layouts available");
+	keyboard = &kb_group->wlr_group->keyboard;
+	if (!(keymap = compile_keymap())) {
+		wlr_log(WLR_ERROR, "Failed to create keymap for layouts: %s",
+				xkb_rules.layout);
 		return;
 	}
-
-	// Create context
-	struct xkb_context *context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
-	if (!context) {
-		wlr_log(WLR_ERROR, "Failed to create XKB context");
+	if (keymap == keyboard->keymap)
 		return;
-	}
-
-	// Get layout abbreviations
-	char **layout_ids = calloc(num_layouts, sizeof(char *));
-	if (!layout_ids) {
-		wlr_log(WLR_ERROR, "Failed to allocate layout IDs");
-		goto cleanup_context;
-	}
-
-	for (int i = 0; i < num_layouts; i++) {
-		layout_ids[i] =
-			get_layout_abbr(xkb_keymap_layout_get_name(keyboard->keymap, i));
-		if (!layout_ids[i]) {
-			wlr_log(WLR_ERROR, "Failed to get layout abbreviation");
-			goto cleanup_layouts;
-		}
-	}
-
-	// Keep the same rules but just reapply them
-	struct xkb_rule_names rules = xkb_rules;
-
-	// Create new keymap with current rules
-	struct xkb_keymap *new_keymap =
-		xkb_keymap_new_from_names(context, &rules, XKB_KEYMAP_COMPILE_NO_FLAGS);
-	if (!new_keymap) {
-		wlr_log(WLR_ERROR, "Failed to create keymap for layouts: %s",
-				rules.layout);
-		goto cleanup_layouts;
-	}
-
-	// Apply the same keymap (this will reset the layout state)
-	unsigned int depressed = keyboard->modifiers.depressed;
-	unsigned int latched = keyboard->modifiers.latched;
-	unsigned int locked = keyboard->modifiers.locked;
-
-	wlr_keyboard_set_keymap(keyboard, new_keymap);
-
-	wlr_keyboard_notify_modifiers(keyboard, depressed, latched, locked, 0);
-	keyboard->modifiers.group = current; // Keep the same layout index
-
-	// Update seat
-	wlr_seat_set_keyboard(seat, keyboard);
-	wlr_seat_keyboard_notify_modifiers(seat, &keyboard->modifiers);
 
-	// Cleanup
-	xkb_keymap_unref(new_keymap);
+	current = keyboard->keymap ? xkb_state_serialize_layout(
+									 keyboard->xkb_state,
+									 XKB_STATE_LAYOUT_EFFECTIVE)
+							   : 0;
 
-cleanup_layouts:
-	for (int i = 0; i < num_layouts; i++) {
-		free(layout_ids[i]);
+	// 同理改成员键盘,keyboard group会把keymap同步给其他成员和组
+	target = keyboard;
+	if (!wl_list_empty(&keyboards)) {
+		kb = wl_container_of(keyboards.next, kb, link);
+		target = kb->wlr_keyboard;
 	}
-	free(layout_ids);
+	wlr_keyboard_set_keymap(target, keymap);
+	if (keyboard->keymap != keymap)
+		wlr_keyboard_set_keymap(keyboard, keymap);
 
-cleanup_context:
-	xkb_context_unref(context);
+	num_layouts = xkb_keymap_num_layouts(keymap);
+	set_keyboard_layout_group(current < num_layouts ? current : 0);
 }
 
 void switch_keyboard_layout(const Arg *arg) {
+	struct wlr_keyboard *keyboard;
+	xkb_layout_index_t current, num_layouts;
+
 	if (!kb_group || !kb_group->wlr_group || !seat) {
 		wlr_log(WLR_ERROR, "Invalid keyboard group or seat");
 		return;
 	}
 
-	struct wlr_keyboard *keyboard = &kb_group->wlr_group->keyboard;
-	if (!keyboard || !keyboard->keymap) {
+	keyboard = &kb_group->wlr_group->keyboard;
+	if (!keyboard->keymap) {
 		wlr_log(WLR_ERROR, "Invalid keyboard or keymap");
 		return;
 	}
 
-	// 1. 获取当前布局和计算下一个布局
-	xkb_layout_index_t current = xkb_state_serialize_layout(
-		keyboard->xkb_state, XKB_STATE_LAYOUT_EFFECTIVE);
-	const int num_layouts = xkb_keymap_num_layouts(keyboard->keymap);
+	current = xkb_state_serialize_layout(keyboard->xkb_state,
+										 XKB_STATE_LAYOUT_EFFECTIVE);
+	num_layouts = xkb_keymap_num_layouts(keyboard->keymap);
 	if (num_layouts < 2) {
 		wlr_log(WLR_INFO, "Only one layout available");
 		return;
 	}
-	xkb_layout_index_t next = (current + 1) % num_layouts;
-
-	// 2. 创建上下文
-	struct xkb_context *context = xkb_context_new(XKB_CONTEXT_NO_FLAGS);
-	if (!context) {
-		wlr_log(WLR_ERROR, "Failed to create XKB context");
-		return;
-	}
-
-	// 3. 分配并获取布局缩写
-	char **layout_ids = calloc(num_layouts, sizeof(char *));
-	if (!layout_ids) {
-		wlr_log(WLR_ERROR, "Failed to allocate layout IDs");
-		goto cleanup_context;
-	}
-
-	for (int i = 0; i < num_layouts; i++) {
-		layout_ids[i] =
-			get_layout_abbr(xkb_keymap_layout_get_name(keyboard->keymap, i));
-		if (!layout_ids[i]) {
-			wlr_log(WLR_ERROR, "Failed to get layout abbreviation");
-			goto cleanup_layouts;
-		}
-	}
-
-	// 4. 直接修改 rules.layout（保持原有逻辑）
-	struct xkb_rule_names rules = xkb_rules;
-	char *layout_buf = (char *)rules.layout; // 假设这是可修改的
-
-	// 清空原有内容（安全方式）
-	unsigned int layout_buf_size = strlen(layout_buf) + 1;
-	memset(layout_buf, 0, layout_buf_size);
-
-	// 构建新的布局字符串
-	for (int i = 0; i < num_layouts; i++) {
-		const char *layout = layout_ids[(next + i) % num_layouts];
-
-		if (i > 0) {
-			strncat(layout_buf, ",", layout_buf_size - strlen(layout_buf) - 1);
-		}
-
-		if (strchr(layout, ',')) {
-			// 处理包含逗号的布局名
-			char *quoted = malloc(strlen(layout) + 3);
-			if (quoted) {
-				snprintf(quoted, strlen(layout) + 3, "\"%s\"", layout);
-				strncat(layout_buf, quoted,
-						layout_buf_size - strlen(layout_buf) - 1);
-				free(quoted);
-			}
-		} else {
-			strncat(layout_buf, layout,
-					layout_buf_size - strlen(layout_buf) - 1);
-		}
-	}
-
-	// 5. 创建新 keymap
-	struct xkb_keymap *new_keymap =
-		xkb_keymap_new_from_names(context, &rules, XKB_KEYMAP_COMPILE_NO_FLAGS);
-	if (!new_keymap) {
-		wlr_log(WLR_ERROR, "Failed to create keymap for layouts: %s",
-				rules.layout);
-		goto cleanup_layouts;
-	}
-
-	// 6. 应用新 keymap
-	unsigned int depressed = keyboard->modifiers.depressed;
-	unsigned int latched = keyboard->modifiers.latched;
-	unsigned int locked = keyboard->modifiers.locked;
-
-	wlr_keyboard_set_keymap(keyboard, new_keymap);
-	wlr_keyboard_notify_modifiers(keyboard, depressed, latched, locked, 0);
-	keyboard->modifiers.group = 0;
-
-	// 7. 更新 seat
-	wlr_seat_set_keyboard(seat, keyboard);
-	wlr_seat_keyboard_notify_modifiers(seat, &keyboard->modifiers);
-
-	// 8. 清理资源
-	xkb_keymap_unref(new_keymap);
-
-cleanup_layouts:
-	for (int i = 0; i < num_layouts; i++) {
-		free(layout_ids[i]);
-	}
-	free(layout_ids);
 
-cleanup_context:
-	xkb_context_unref(context);
+	set_keyboard_layout_group((current + 1) % num_layouts);
 }
 
 void switch_layout(const Arg *arg) {
@@ -5162,6 +5506,131 @@ void setsmfact(const Arg *arg) {
 	arrange(selmon, false);
 }
 
+// 窗口加入clients链表后建立标签索引
+void client_attach_tagindex(Client *c) {
+	unsigned int i;
+
+	if (!c->tag_links) {
+		c->tag_links = ecalloc(LENGTH(tags) + 1, sizeof(*c->tag_links));
+		for (i = 0; i <= LENGTH(tags); i++) {
+			c->tag_links[i].c = c;
+			wl_list_init(&c->tag_links[i].link);
+		}
+		wl_list_init(&c->tag_changed_link);
+	}
+	client_update_tagindex(c);
+}
+
+// 窗口离开clients链表时移除标签索引
+void client_detach_tagindex(Client *c) {
+	if (!c->tag_links)
+		return;
+	client_remove_tagindex(c);
+	free(c->tag_links);
+	c->tag_links = NULL;
+}
+
+void client_remove_tagindex(Client *c) {
+	unsigned int i;
+
+	if (!c->tag_links)
+		return;
+
+	for (i = 0; i <= LENGTH(tags); i++) {
+		if (i < LENGTH(tags) && c->index_mon &&
+			!wl_list_empty(&c->tag_links[i].link)) {
+			c->index_mon->pertag->nclients[i]--;
+			c->index_mon->pertag->nurgent[i] -= c->isurgent ? 1 : 0;
+		}
+		wl_list_remove(&c->tag_links[i].link);
+		wl_list_init(&c->tag_links[i].link);
+	}
+	wl_list_remove(&c->tag_changed_link);
+	wl_list_init(&c->tag_changed_link);
+	c->index_mon = NULL;
+	c->index_tags = 0;
+	spatial_index_invalidate();
+}
+
+// 修改了c->mon,c->tags或者global状态之后都要调用
+void client_update_tagindex(Client *c) {
+	Monitor *m = c->mon;
+	unsigned int i, newtags;
+	bool member;
+
+	if (!c->tag_links)
+		return;
+
+	if (c->index_mon && c->index_mon != m)
+		client_remove_tagindex(c);
+
+	if (!m)
+		return;
+
+	newtags = c->tags & TAGMASK;
+	for (i = 0; i <= LENGTH(tags); i++) {
+		member = i < LENGTH(tags) ? newtags & (1 << i)
+								  : c->isglobal || c->isunglobal;
+		if (member && wl_list_empty(&c->tag_links[i].link)) {
+			wl_list_insert(&m->pertag->tag_clients[i], &c->tag_links[i].link);
+			if (i < LENGTH(tags)) {
+				m->pertag->nclients[i]++;
+				m->pertag->nurgent[i] += c->isurgent ? 1 : 0;
+			}
+		} else if (!member && !wl_list_empty(&c->tag_links[i].link)) {
+			wl_list_remove(&c->tag_links[i].link);
+			wl_list_init(&c->tag_links[i].link);
+			if (i < LENGTH(tags)) {
+				m->pertag->nclients[i]--;
+				m->pertag->nurgent[i] -= c->isurgent ? 1 : 0;
+			}
+		}
+	}
+
+	// 标签变了,下一次arrange要重新计算它的可见状态
+	if (c->index_mon != m || c->index_tags != newtags) {
+		if (wl_list_empty(&c->tag_changed_link))
+			wl_list_insert(&m->tag_changed_clients, &c->tag_changed_link);
+		spatial_index_invalidate();
+	}
+
+	c->index_mon = m;
+	c->index_tags = newtags;
+}
+
+// 窗口加入索引后修改isurgent要走这里,维护每个标签的紧急窗口计数
+void client_set_urgent(Client *c, int urgent) {
+	unsigned int i;
+
+	urgent = urgent ? 1 : 0;
+	if (c->isurgent == urgent)
+		return;
+	c->isurgent = urgent;
+
+	if (!c->index_mon)
+		return;
+
+	for (i = 0; i < LENGTH(tags); i++) {
+		if (wl_list_empty(&c->tag_links[i].link))
+			continue;
+		if (urgent)
+			c->index_mon->pertag->nurgent[i]++;
+		else
+			c->index_mon->pertag->nurgent[i]--;
+	}
+}
+
+bool tagindex_has_clients(Monitor *m, unsigned int tagmask) {
+	unsigned int i;
+
+	for (i = 0; i < LENGTH(tags); i++) {
+		if ((tagmask & (1 << i)) &&
+			!wl_list_empty(&m->pertag->tag_clients[i]))
+			return true;
+	}
+	return false;
+}
+
 void setmon(Client *c, Monitor *m, unsigned int newtags, bool focus) {
 	Monitor *oldmon = c->mon;
 
@@ -5177,6 +5646,7 @@ void setmon(Client *c, Monitor *m, unsigned int newtags, bool focus) {
 	}
 
 	c->mon = m;
+	client_update_tagindex(c);
 
 	/* Scene graph sends surface leave/enter events on move and resize */
 	if (oldmon)
@@ -5187,6 +5657,7 @@ void setmon(Client *c, Monitor *m, unsigned int newtags, bool focus) {
 		c->tags =
 			newtags ? newtags
 					: m->tagset[m->seltags]; /* assign tags of target monitor */
+		client_update_tagindex(c);
 		setfloating(c, c->isfloating);
 		setfullscreen(c, c->isfullscreen); /* This will call arrange(c->mon) */
 	}
@@ -5332,6 +5803,9 @@ void setup(void) {
 	for (i = 0; i < LENGTH(sig); i++)
 		sigaction(sig[i], &sa, NULL);
 
+	// 在打开显示和显卡之前启动,这时候fork的代价最小
+	launcher_start();
+
 	wlr_log_init(log_level, NULL);
 
 	/* The Wayland display is managed by libwayland. It handles accepting
@@ -5399,6 +5873,7 @@ void setup(void) {
 	 * that the clients cannot set the selection directly without compositor
 	 * approval, see the setsel() function. */
 	compositor = wlr_compositor_create(dpy, 6, drw);
+	wl_signal_add(&compositor->events.new_surface, &new_surface);
 	wlr_export_dmabuf_manager_v1_create(dpy);
 	wlr_screencopy_manager_v1_create(dpy);
 	wlr_ext_image_copy_capture_manager_v1_create(dpy, 1);
@@ -5445,6 +5920,7 @@ void setup(void) {
 	wl_list_init(&fstack);
 	wl_list_init(&fadeout_clients);
 	wl_list_init(&fadeout_layers);
+	wl_list_init(&fadeout_pool);
 
 	idle_notifier = wlr_idle_notifier_v1_create(dpy);
 
@@ -5518,6 +5994,7 @@ void setup(void) {
 				  &request_set_cursor_shape);
 	hide_source = wl_event_loop_add_timer(wl_display_get_event_loop(dpy),
 										  hidecursor, cursor);
+	frame_stats_schedule_log();
 
 	/*
 	 * Configures a seat, which is a single "seat" at which a user sits and
@@ -5551,6 +6028,8 @@ void setup(void) {
 				  &request_set_psel);
 	wl_signal_add(&seat->events.request_start_drag, &request_start_drag);
 	wl_signal_add(&seat->events.start_drag, &start_drag);
+	wl_signal_add(&seat->pointer_state.events.focus_change,
+				  &pointer_focus_change);
 
 	kb_group = createkeyboardgroup();
 	wl_list_init(&kb_group->destroy.link);
@@ -5599,54 +6078,26 @@ void setup(void) {
 }
 
 void spawn(const Arg *arg) {
+	LaunchRecord *r;
+	pid_t pid;
 
 	if (!arg->v)
 		return;
 
-	if (fork() == 0) {
-		// 1. 忽略可能导致 coredump 的信号
-		signal(SIGSEGV, SIG_IGN);
-		signal(SIGABRT, SIG_IGN);
-		signal(SIGILL, SIG_IGN);
-
-		dup2(STDERR_FILENO, STDOUT_FILENO);
-		setsid();
-
-		// 2. 解析参数
-		char *argv[64];
-		int argc = 0;
-		char *token = strtok((char *)arg->v, " ");
-		while (token != NULL && argc < 63) {
-			wordexp_t p;
-			if (wordexp(token, &p, 0) == 0) {
-				argv[argc++] = p.we_wordv[0];
-			} else {
-				argv[argc++] = token;
-			}
-			token = strtok(NULL, " ");
-		}
-		argv[argc] = NULL;
-
-		// 3. 执行命令
-		execvp(argv[0], argv);
-
-		// 4. execvp 失败时：打印错误并直接退出（避免 coredump）
-		wlr_log(WLR_ERROR, "dwl: execvp '%s' failed: %s\n", argv[0],
-				strerror(errno));
-		_exit(EXIT_FAILURE); // 使用 _exit 避免缓冲区刷新等操作
+	r = launch_stats_spawn(arg->v);
+	if (launcher_spawn(arg->v)) {
+		r->awaiting_pid = true;
+		return;
 	}
+
+	if ((pid = fork()) == 0)
+		spawn_exec((char *)arg->v);
+	r->pid = pid > 0 ? pid : 0;
 }
 
 void spawn_on_empty(const Arg *arg) {
-	bool is_empty = true;
-	Client *c;
+	bool is_empty = !tagindex_has_clients(selmon, arg->ui);
 
-	wl_list_for_each(c, &clients, link) {
-		if (arg->ui & c->tags && c->mon == selmon) {
-			is_empty = false;
-			break;
-		}
-	}
 	if (!is_empty) {
 		view(arg, true);
 		return;
@@ -5669,6 +6120,7 @@ void tag_client(const Arg *arg, Client *target_client) {
 	Client *fc;
 	if (target_client && arg->ui & TAGMASK) {
 		target_client->tags = arg->ui & TAGMASK;
+		client_update_tagindex(target_client);
 		wl_list_for_each(fc, &clients, link) {
 			if (fc && fc != target_client && target_client->tags & fc->tags &&
 				ISFULLSCREEN(fc) && !target_client->isfloating) {
@@ -5694,6 +6146,7 @@ void tagsilent(const Arg *arg) {
 	Client *fc;
 	Client *target_client = selmon->sel;
 	target_client->tags = arg->ui & TAGMASK;
+	client_update_tagindex(target_client);
 	wl_list_for_each(fc, &clients, link) {
 		if (fc && fc != target_client && target_client->tags & fc->tags &&
 			ISFULLSCREEN(fc) && !target_client->isfloating) {
@@ -5707,9 +6160,9 @@ void tagsilent(const Arg *arg) {
 void client_update_oldmonname_record(Client *c, Monitor *m) {
 	if (!c || c->iskilling || !client_surface(c)->mapped)
 		return;
-	memset(c->oldmonname, 0, sizeof(c->oldmonname));
-	strncpy(c->oldmonname, m->wlr_output->name, sizeof(c->oldmonname) - 1);
-	c->oldmonname[sizeof(c->oldmonname) - 1] = '\0';
+	memset(c->cold->oldmonname, 0, sizeof(c->cold->oldmonname));
+	strncpy(c->cold->oldmonname, m->wlr_output->name, sizeof(c->cold->oldmonname) - 1);
+	c->cold->oldmonname[sizeof(c->cold->oldmonname) - 1] = '\0';
 }
 
 void tagmon(const Arg *arg) {
@@ -5774,15 +6227,15 @@ unsigned int want_restore_fullscreen(Client *target_client) {
 
 // 普通视图切换到overview时保存窗口的旧状态
 void overview_backup(Client *c) {
-	c->overview_isfloatingbak = c->isfloating;
+	c->cold->overview_isfloatingbak = c->isfloating;
 	c->overview_isfullscreenbak = c->isfullscreen;
 	c->overview_ismaxmizescreenbak = c->ismaxmizescreen;
 	c->overview_isfullscreenbak = c->isfullscreen;
 	c->animation.tagining = false;
 	c->animation.tagouted = false;
 	c->animation.tagouting = false;
-	c->overview_backup_geom = c->geom;
-	c->overview_backup_bw = c->bw;
+	c->cold->overview_backup_geom = c->geom;
+	c->cold->overview_backup_bw = c->bw;
 	if (c->isfloating) {
 		c->isfloating = 0;
 	}
@@ -5795,20 +6248,20 @@ void overview_backup(Client *c) {
 
 // overview切回到普通视图还原窗口的状态
 void overview_restore(Client *c, const Arg *arg) {
-	c->isfloating = c->overview_isfloatingbak;
+	c->isfloating = c->cold->overview_isfloatingbak;
 	c->isfullscreen = c->overview_isfullscreenbak;
 	c->ismaxmizescreen = c->overview_ismaxmizescreenbak;
-	c->overview_isfloatingbak = 0;
+	c->cold->overview_isfloatingbak = 0;
 	c->overview_isfullscreenbak = 0;
 	c->overview_ismaxmizescreenbak = 0;
-	c->geom = c->overview_backup_geom;
-	c->bw = c->overview_backup_bw;
+	c->geom = c->cold->overview_backup_geom;
+	c->bw = c->cold->overview_backup_bw;
 	c->animation.tagining = false;
 	c->is_restoring_from_ov = (arg->ui & c->tags & TAGMASK) == 0 ? true : false;
 
 	if (c->isfloating) {
 		// XRaiseWindow(dpy, c->win); // 提升悬浮窗口到顶层
-		resize(c, c->overview_backup_geom, 0);
+		resize(c, c->cold->overview_backup_geom, 0);
 	} else if (c->isfullscreen || c->ismaxmizescreen) {
 		if (want_restore_fullscreen(c) && c->ismaxmizescreen) {
 			setmaxmizescreen(c, 1);
@@ -5822,7 +6275,7 @@ void overview_restore(Client *c, const Arg *arg) {
 	} else {
 		if (c->is_restoring_from_ov) {
 			c->is_restoring_from_ov = false;
-			resize(c, c->overview_backup_geom, 0);
+			resize(c, c->cold->overview_backup_geom, 0);
 		}
 	}
 
@@ -5895,6 +6348,35 @@ void handlecursoractivity(void) {
 							   last_cursor.hotspot_x, last_cursor.hotspot_y);
 }
 
+void schedule_pointer_refocus(void) {
+	pointer_focus_dirty = true;
+	if (!deferred_focus_source)
+		deferred_focus_source =
+			wl_event_loop_add_idle(event_loop, flush_deferred_focus, NULL);
+}
+
+void schedule_idle_inhibit_check(void) {
+	idle_inhibit_dirty = true;
+	if (!deferred_focus_source)
+		deferred_focus_source =
+			wl_event_loop_add_idle(event_loop, flush_deferred_focus, NULL);
+}
+
+/* 一次事件循环里多次arrange或者focusclient只需要做一次命中测试 */
+void flush_deferred_focus(void *data) {
+	deferred_focus_source = NULL;
+
+	if (pointer_focus_dirty) {
+		pointer_focus_dirty = false;
+		motionnotify(0, NULL, 0, 0, 0, 0);
+	}
+
+	if (idle_inhibit_dirty) {
+		idle_inhibit_dirty = false;
+		checkidleinhibitor(NULL);
+	}
+}
+
 int hidecursor(void *data) {
 	wlr_cursor_unset_image(cursor);
 	cursor_hidden = true;
@@ -5916,6 +6398,8 @@ void increase_proportion(const Arg *arg) {
 void toggleoverview(const Arg *arg) {
 
 	Client *c;
+	TagLink *tl;
+	unsigned int i;
 
 	if (selmon->isoverview && ov_tab_mode && arg->i != -1 && selmon->sel) {
 		focusstack(&(Arg){.i = 1});
@@ -5927,12 +6411,15 @@ void toggleoverview(const Arg *arg) {
 	unsigned int visible_client_number = 0;
 
 	if (selmon->isoverview) {
-		wl_list_for_each(c, &clients,
-						 link) if (c && c->mon == selmon &&
-								   !client_is_unmanaged(c) &&
-								   !client_should_ignore_focus(c) &&
-								   !c->isminied && !c->isunglobal) {
-			visible_client_number++;
+		for (i = 0; i < LENGTH(tags) && !visible_client_number; i++) {
+			wl_list_for_each(tl, &selmon->pertag->tag_clients[i], link) {
+				c = tl->c;
+				if (!client_should_ignore_focus(c) && !c->isminied &&
+					!c->isunglobal) {
+					visible_client_number++;
+					break;
+				}
+			}
 		}
 		if (visible_client_number > 0) {
 			target = ~0;
@@ -5998,8 +6485,8 @@ void togglefullscreen(const Arg *arg) {
 	if (!sel)
 		return;
 
-	sel->is_scratchpad_show = 0;
-	sel->is_in_scratchpad = 0;
+	sel->cold->is_scratchpad_show = 0;
+	sel->cold->is_in_scratchpad = 0;
 	sel->isnamedscratchpad = 0;
 
 	if (sel->isfullscreen || sel->ismaxmizescreen)
@@ -6013,8 +6500,8 @@ void togglemaxmizescreen(const Arg *arg) {
 	if (!sel)
 		return;
 
-	sel->is_scratchpad_show = 0;
-	sel->is_in_scratchpad = 0;
+	sel->cold->is_scratchpad_show = 0;
+	sel->cold->is_in_scratchpad = 0;
 	sel->isnamedscratchpad = 0;
 
 	if (sel->isfullscreen || sel->ismaxmizescreen)
@@ -6036,6 +6523,7 @@ void toggletag(const Arg *arg) {
 	newtags = sel->tags ^ (arg->ui & TAGMASK);
 	if (newtags) {
 		sel->tags = newtags;
+		client_update_tagindex(sel);
 		focusclient(focustop(selmon), 1);
 		arrange(selmon, false);
 	}
@@ -6067,6 +6555,7 @@ void unmaplayersurfacenotify(struct wl_listener *listener, void *data) {
 	init_fadeout_layers(l);
 
 	wlr_scene_node_set_enabled(&l->scene->node, false);
+	scene_generation++;
 	if (l == exclusive_focus)
 		exclusive_focus = NULL;
 	if (l->layer_surface->output && (l->mon = l->layer_surface->output->data))
@@ -6081,6 +6570,7 @@ void unmapnotify(struct wl_listener *listener, void *data) {
 	Client *c = wl_container_of(listener, c, unmap);
 	Monitor *m;
 	c->iskilling = 1;
+	scene_generation++;
 
 	if (animations && !c->is_clip_to_hide && !c->isminied &&
 		(!c->mon || VISIBLEON(c, c->mon)))
@@ -6134,6 +6624,7 @@ void unmapnotify(struct wl_listener *listener, void *data) {
 	} else {
 		if (!c->swallowing)
 			wl_list_remove(&c->link);
+		client_detach_tagindex(c);
 		setmon(c, NULL, 0, true);
 		if (!c->swallowing)
 			wl_list_remove(&c->flink);
@@ -6231,7 +6722,7 @@ void updatemons(struct wl_listener *listener, void *data) {
 
 			// restore window to old monitor
 			if (c->mon && c->mon != m && client_surface(c)->mapped &&
-				strcmp(c->oldmonname, m->wlr_output->name) == 0) {
+				strcmp(c->cold->oldmonname, m->wlr_output->name) == 0) {
 				client_change_mon(c, m);
 			}
 		}
@@ -6326,7 +6817,7 @@ urgent(struct wl_listener *listener, void *data) {
 	} else if (c != focustop(selmon)) {
 		if (client_surface(c)->mapped)
 			client_set_border_color(c, urgentcolor);
-		c->isurgent = 1;
+		client_set_urgent(c, 1);
 		printstatus();
 	}
 }
@@ -6602,13 +7093,209 @@ Monitor *xytomon(double x, double y) {
 	return o ? o->data : NULL;
 }
 
+/* xytonode()的命中缓存.
+ * box是光标在里面移动时命中结果不会变的区域:命中节点自身的范围,
+ * 再裁掉所有叠在它上面的节点.scene_generation没变并且光标还在box里时,
+ * 直接返回上一次的结果 */
+static struct {
+	unsigned int generation;
+	struct wlr_box box;
+	struct wlr_scene_node *node; /* NULL表示光标下什么都没有 */
+	int lx, ly;					 /* node的layout坐标 */
+	struct wlr_surface *surface;
+	Client *c;
+	LayerSurface *l;
+	struct wl_listener node_destroy;
+} hit_cache;
+
+static void hit_cache_node_destroy(struct wl_listener *listener, void *data) {
+	wl_list_remove(&hit_cache.node_destroy.link);
+	hit_cache.node = NULL;
+	hit_cache.generation = 0;
+}
+
+// 节点在layout坐标下的范围,不知道大小的节点返回false
+static bool scene_node_box(struct wlr_scene_node *node, int lx, int ly,
+						   struct wlr_box *box) {
+	struct wlr_scene_buffer *buffer;
+
+	*box = (struct wlr_box){.x = lx, .y = ly};
+
+	switch (node->type) {
+	case WLR_SCENE_NODE_RECT:
+		box->width = wlr_scene_rect_from_node(node)->width;
+		box->height = wlr_scene_rect_from_node(node)->height;
+		return true;
+	case WLR_SCENE_NODE_SHADOW:
+		box->width = wlr_scene_shadow_from_node(node)->width;
+		box->height = wlr_scene_shadow_from_node(node)->height;
+		return true;
+	case WLR_SCENE_NODE_BUFFER:
+		buffer = wlr_scene_buffer_from_node(node);
+		if (buffer->dst_width > 0 && buffer->dst_height > 0) {
+			box->width = buffer->dst_width;
+			box->height = buffer->dst_height;
+		} else if (buffer->buffer &&
+				   (buffer->transform & WL_OUTPUT_TRANSFORM_90)) {
+			box->width = buffer->buffer->height;
+			box->height = buffer->buffer->width;
+		} else if (buffer->buffer) {
+			box->width = buffer->buffer->width;
+			box->height = buffer->buffer->height;
+		}
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* 把o从box里裁掉,保留(x, y)所在的那一侧里面积最大的 */
+static void hit_box_exclude(struct wlr_box *box, const struct wlr_box *o,
+							double x, double y) {
+	struct wlr_box tmp, best = {0}, cut;
+	long long int area, best_area = -1;
+	int i;
+
+	if (!wlr_box_intersection(&tmp, box, o))
+		return;
+
+	for (i = 0; i < 4; i++) {
+		cut = *box;
+		if (i == 0 && o->x + o->width <= x) {
+			cut.x = o->x + o->width;
+			cut.width = box->x + box->width - cut.x;
+		} else if (i == 1 && x < o->x) {
+			cut.width = o->x - box->x;
+		} else if (i == 2 && o->y + o->height <= y) {
+			cut.y = o->y + o->height;
+			cut.height = box->y + box->height - cut.y;
+		} else if (i == 3 && y < o->y) {
+			cut.height = o->y - box->y;
+		} else {
+			continue;
+		}
+		area = (long long int)cut.width * cut.height;
+		if (area > best_area) {
+			best_area = area;
+			best = cut;
+		}
+	}
+
+	/* 四个方向都裁不掉说明(x, y)就在o里面,只是o在这一点不接收输入,
+	 * 这时box清空,不缓存 */
+	*box = best;
+}
+
+/* 从上往下遍历,直到遇到命中的节点,返回true表示已经遇到 */
+static bool hit_cache_clip(struct wlr_scene_node *node, int lx, int ly,
+						   struct wlr_scene_node *hit, double x, double y) {
+	struct wlr_scene_tree *tree;
+	struct wlr_scene_node *child;
+	struct wlr_box box;
+
+	if (!node->enabled)
+		return false;
+
+	if (node == hit)
+		return true;
+
+	if (node->type == WLR_SCENE_NODE_TREE) {
+		tree = wlr_scene_tree_from_node(node);
+		wl_list_for_each_reverse(child, &tree->children, link) {
+			if (hit_cache_clip(child, lx + child->x, ly + child->y, hit, x, y))
+				return true;
+		}
+		return false;
+	}
+
+	if (!scene_node_box(node, lx, ly, &box))
+		hit_cache.box = (struct wlr_box){0};
+	else if (!wlr_box_empty(&box))
+		hit_box_exclude(&hit_cache.box, &box, x, y);
+
+	return false;
+}
+
+static void hit_cache_store(double x, double y, struct wlr_scene_node *hit,
+							int hit_layer, struct wlr_surface *surface,
+							Client *c, LayerSurface *l) {
+	int layer, lx, ly;
+
+	if (hit_cache.node)
+		wl_list_remove(&hit_cache.node_destroy.link);
+	hit_cache.node = NULL;
+
+	if (hit) {
+		wlr_scene_node_coords(hit, &hit_cache.lx, &hit_cache.ly);
+		scene_node_box(hit, hit_cache.lx, hit_cache.ly, &hit_cache.box);
+	} else {
+		hit_cache.box = (struct wlr_box){INT_MIN / 2, INT_MIN / 2, INT_MAX,
+										 INT_MAX};
+	}
+
+	for (layer = NUM_LAYERS - 1; layer >= 0 && layer >= hit_layer; layer--) {
+		if (layer == LyrIMPopup || layer == LyrFadeOut)
+			continue;
+		wlr_scene_node_coords(&layers[layer]->node, &lx, &ly);
+		if (hit_cache_clip(&layers[layer]->node, lx, ly, hit, x, y))
+			break;
+	}
+
+	if (hit) {
+		hit_cache.node = hit;
+		hit_cache.node_destroy.notify = hit_cache_node_destroy;
+		wl_signal_add(&hit->events.destroy, &hit_cache.node_destroy);
+	}
+	hit_cache.surface = surface;
+	hit_cache.c = c;
+	hit_cache.l = l;
+	hit_cache.generation = scene_generation;
+}
+
+static bool hit_cache_lookup(double x, double y, struct wlr_surface **psurface,
+							 Client **pc, LayerSurface **pl, double *nx,
+							 double *ny) {
+	struct wlr_scene_buffer *buffer;
+	double sx, sy;
+
+	if (hit_cache.generation != scene_generation || x < hit_cache.box.x ||
+		y < hit_cache.box.y || x >= hit_cache.box.x + hit_cache.box.width ||
+		y >= hit_cache.box.y + hit_cache.box.height)
+		return false;
+
+	if (hit_cache.node) {
+		// 输入区域不一定是矩形,还要surface自己确认
+		sx = x - hit_cache.lx;
+		sy = y - hit_cache.ly;
+		buffer = wlr_scene_buffer_from_node(hit_cache.node);
+		if (buffer->point_accepts_input &&
+			!buffer->point_accepts_input(buffer, &sx, &sy))
+			return false;
+		if (nx)
+			*nx = sx;
+		if (ny)
+			*ny = sy;
+	}
+
+	if (psurface)
+		*psurface = hit_cache.surface;
+	if (pc)
+		*pc = hit_cache.c;
+	if (pl)
+		*pl = hit_cache.l;
+	return true;
+}
+
 void xytonode(double x, double y, struct wlr_surface **psurface, Client **pc,
 			  LayerSurface **pl, double *nx, double *ny) {
-	struct wlr_scene_node *node, *pnode;
+	struct wlr_scene_node *node = NULL, *pnode, *hit = NULL;
 	struct wlr_surface *surface = NULL;
 	Client *c = NULL;
 	LayerSurface *l = NULL;
-	int layer;
+	int layer, hit_layer = -1;
+
+	if (hit_cache_lookup(x, y, psurface, pc, pl, nx, ny))
+		return;
 
 	for (layer = NUM_LAYERS - 1; !surface && layer >= 0; layer--) {
 
@@ -6622,6 +7309,11 @@ void xytonode(double x, double y, struct wlr_surface **psurface, Client **pc,
 		if (!(node = wlr_scene_node_at(&layers[layer]->node, x, y, nx, ny)))
 			continue;
 
+		if (!hit) {
+			hit = node;
+			hit_layer = layer;
+		}
+
 		if (node->type == WLR_SCENE_NODE_BUFFER)
 			surface = wlr_scene_surface_try_from_buffer(
 						  wlr_scene_buffer_from_node(node))
@@ -6635,6 +7327,11 @@ void xytonode(double x, double y, struct wlr_surface **psurface, Client **pc,
 		}
 	}
 
+	/* 最上面命中的是边框这类没有surface的节点时,结果还要看下面的层,
+	 * 这种情况不缓存 */
+	if (!hit || (surface && node == hit))
+		hit_cache_store(x, y, hit, hit_layer, surface, c, l);
+
 	if (psurface)
 		*psurface = surface;
 	if (pc)
@@ -6646,12 +7343,13 @@ void xytonode(double x, double y, struct wlr_surface **psurface, Client **pc,
 void toggleglobal(const Arg *arg) {
 	if (!selmon->sel)
 		return;
-	if (selmon->sel->is_in_scratchpad) {
-		selmon->sel->is_in_scratchpad = 0;
-		selmon->sel->is_scratchpad_show = 0;
+	if (selmon->sel->cold->is_in_scratchpad) {
+		selmon->sel->cold->is_in_scratchpad = 0;
+		selmon->sel->cold->is_scratchpad_show = 0;
 		selmon->sel->isnamedscratchpad = 0;
 	}
 	selmon->sel->isglobal ^= 1;
+	client_update_tagindex(selmon->sel);
 	//   selmon->sel->tags =
 	//       selmon->sel->isglobal ? TAGMASK : selmon->tagset[selmon->seltags];
 	//   focustop(selmon);
@@ -6765,7 +7463,7 @@ void movewin(const Arg *arg) {
 void smartmovewin(const Arg *arg) {
 	Client *c, *tc;
 	int nx, ny;
-	int buttom, top, left, right, tar;
+	int buttom, top, left, right;
 	c = selmon->sel;
 	if (!c || c->isfullscreen)
 		return;
@@ -6776,81 +7474,46 @@ void smartmovewin(const Arg *arg) {
 
 	switch (arg->i) {
 	case UP:
-		tar = -99999;
 		top = c->geom.y;
 		ny -= c->mon->w.height / 4;
 
-		wl_list_for_each(tc, &clients, link) {
-			if (!VISIBLEON(tc, selmon) || !tc->isfloating || tc == c)
-				continue;
-			if (c->geom.x + c->geom.width < tc->geom.x ||
-				c->geom.x > tc->geom.x + tc->geom.width)
-				continue;
-			buttom = tc->geom.y + tc->geom.height + gappiv;
-			if (top > buttom && ny < buttom) {
-				tar = MAX(tar, buttom);
-			};
-		}
-
-		ny = tar == -99999 ? ny : tar;
+		// 移动范围内最靠下的底边
+		tc = spatial_find_edge(SpatialBottom, ny - (int)gappiv + 1,
+							   top - (int)gappiv - 1, true, c,
+							   spatial_match_floating_overlap_x);
+		ny = tc ? tc->geom.y + tc->geom.height + (int)gappiv : ny;
 		ny = MAX(ny, c->mon->w.y + c->mon->gappov);
 		break;
 	case DOWN:
-		tar = 99999;
 		buttom = c->geom.y + c->geom.height;
 		ny += c->mon->w.height / 4;
 
-		wl_list_for_each(tc, &clients, link) {
-			if (!VISIBLEON(tc, selmon) || !tc->isfloating || tc == c)
-				continue;
-			if (c->geom.x + c->geom.width < tc->geom.x ||
-				c->geom.x > tc->geom.x + tc->geom.width)
-				continue;
-			top = tc->geom.y - gappiv;
-			if (buttom < top && (ny + c->geom.height) > top) {
-				tar = MIN(tar, top - c->geom.height);
-			};
-		}
-		ny = tar == 99999 ? ny : tar;
+		// 移动范围内最靠上的顶边
+		tc = spatial_find_edge(SpatialTop, buttom + (int)gappiv + 1,
+							   ny + c->geom.height + (int)gappiv - 1, false, c,
+							   spatial_match_floating_overlap_x);
+		ny = tc ? tc->geom.y - (int)gappiv - c->geom.height : ny;
 		ny = MIN(ny, c->mon->w.y + c->mon->w.height - c->geom.height -
 						 c->mon->gappov);
 		break;
 	case LEFT:
-		tar = -99999;
 		left = c->geom.x;
 		nx -= c->mon->w.width / 6;
 
-		wl_list_for_each(tc, &clients, link) {
-			if (!VISIBLEON(tc, selmon) || !tc->isfloating || tc == c)
-				continue;
-			if (c->geom.y + c->geom.height < tc->geom.y ||
-				c->geom.y > tc->geom.y + tc->geom.height)
-				continue;
-			right = tc->geom.x + tc->geom.width + gappih;
-			if (left > right && nx < right) {
-				tar = MAX(tar, right);
-			};
-		}
-
-		nx = tar == -99999 ? nx : tar;
+		tc = spatial_find_edge(SpatialRight, nx - (int)gappih + 1,
+							   left - (int)gappih - 1, true, c,
+							   spatial_match_floating_overlap_y);
+		nx = tc ? tc->geom.x + tc->geom.width + (int)gappih : nx;
 		nx = MAX(nx, c->mon->w.x + c->mon->gappoh);
 		break;
 	case RIGHT:
-		tar = 99999;
 		right = c->geom.x + c->geom.width;
 		nx += c->mon->w.width / 6;
-		wl_list_for_each(tc, &clients, link) {
-			if (!VISIBLEON(tc, selmon) || !tc->isfloating || tc == c)
-				continue;
-			if (c->geom.y + c->geom.height < tc->geom.y ||
-				c->geom.y > tc->geom.y + tc->geom.height)
-				continue;
-			left = tc->geom.x - gappih;
-			if (right < left && (nx + c->geom.width) > left) {
-				tar = MIN(tar, left - c->geom.width);
-			};
-		}
-		nx = tar == 99999 ? nx : tar;
+
+		tc = spatial_find_edge(SpatialLeft, right + (int)gappih + 1,
+							   nx + c->geom.width + (int)gappih - 1, false, c,
+							   spatial_match_floating_overlap_y);
+		nx = tc ? tc->geom.x - (int)gappih - c->geom.width : nx;
 		nx = MIN(nx, c->mon->w.x + c->mon->w.width - c->geom.width -
 						 c->mon->gappoh);
 		break;
@@ -6865,7 +7528,7 @@ void smartmovewin(const Arg *arg) {
 void smartresizewin(const Arg *arg) {
 	Client *c, *tc;
 	int nw, nh;
-	int buttom, top, left, right, tar;
+	int buttom, right;
 	c = selmon->sel;
 	if (!c || c->isfullscreen)
 		return;
@@ -6880,22 +7543,13 @@ void smartresizewin(const Arg *arg) {
 		nh = MAX(nh, selmon->w.height / 10);
 		break;
 	case DOWN:
-		tar = -99999;
 		buttom = c->geom.y + c->geom.height;
 		nh += selmon->w.height / 8;
 
-		wl_list_for_each(tc, &clients, link) {
-			if (!VISIBLEON(tc, selmon) || !tc->isfloating || tc == c)
-				continue;
-			if (c->geom.x + c->geom.width < tc->geom.x ||
-				c->geom.x > tc->geom.x + tc->geom.width)
-				continue;
-			top = tc->geom.y - gappiv;
-			if (buttom < top && (nh + c->geom.y) > top) {
-				tar = MAX(tar, top - c->geom.y);
-			};
-		}
-		nh = tar == -99999 ? nh : tar;
+		tc = spatial_find_edge(SpatialTop, buttom + (int)gappiv + 1,
+							   nh + c->geom.y + (int)gappiv - 1, true, c,
+							   spatial_match_floating_overlap_x);
+		nh = tc ? tc->geom.y - (int)gappiv - c->geom.y : nh;
 		if (c->geom.y + nh + gappov > selmon->w.y + selmon->w.height)
 			nh = selmon->w.y + selmon->w.height - c->geom.y - gappov;
 		break;
@@ -6904,22 +7558,13 @@ void smartresizewin(const Arg *arg) {
 		nw = MAX(nw, selmon->w.width / 10);
 		break;
 	case RIGHT:
-		tar = 99999;
 		right = c->geom.x + c->geom.width;
 		nw += selmon->w.width / 16;
-		wl_list_for_each(tc, &clients, link) {
-			if (!VISIBLEON(tc, selmon) || !tc->isfloating || tc == c)
-				continue;
-			if (c->geom.y + c->geom.height < tc->geom.y ||
-				c->geom.y > tc->geom.y + tc->geom.height)
-				continue;
-			left = tc->geom.x - gappih;
-			if (right < left && (nw + c->geom.x) > left) {
-				tar = MIN(tar, left - c->geom.x);
-			};
-		}
 
-		nw = tar == 99999 ? nw : tar;
+		tc = spatial_find_edge(SpatialLeft, right + (int)gappih + 1,
+							   nw + c->geom.x + (int)gappih - 1, false, c,
+							   spatial_match_floating_overlap_y);
+		nw = tc ? tc->geom.x - (int)gappih - c->geom.x : nw;
 		if (c->geom.x + nw + gappoh > selmon->w.x + selmon->w.width)
 			nw = selmon->w.x + selmon->w.width - c->geom.x - gappoh;
 		break;
@@ -6944,9 +7589,10 @@ void activatex11(struct wl_listener *listener, void *data) {
 
 	if (c->isminied) {
 		c->isminied = 0;
-		c->tags = c->mini_restore_tag;
-		c->is_scratchpad_show = 0;
-		c->is_in_scratchpad = 0;
+		c->tags = c->cold->mini_restore_tag;
+		client_update_tagindex(c);
+		c->cold->is_scratchpad_show = 0;
+		c->cold->is_in_scratchpad = 0;
 		c->isnamedscratchpad = 0;
 		wlr_foreign_toplevel_handle_v1_set_minimized(c->foreign_toplevel,
 													 false);
@@ -6962,7 +7608,7 @@ void activatex11(struct wl_listener *listener, void *data) {
 		focusclient(c, 1);
 		need_arrange = false;
 	} else if (c != focustop(selmon)) {
-		c->isurgent = 1;
+		client_set_urgent(c, 1);
 		if (client_surface(c)->mapped)
 			client_set_border_color(c, urgentcolor);
 	}
@@ -7007,6 +7653,7 @@ void createnotifyx11(struct wl_listener *listener, void *data) {
 
 	/* Allocate a Client for this surface */
 	c = xsurface->data = ecalloc(1, sizeof(*c));
+	c->cold = ecalloc(1, sizeof(*c->cold));
 	c->surface.xwayland = xsurface;
 	c->type = X11;
 	/* Listen to the various events it can emit */
@@ -7028,12 +7675,20 @@ void associatex11(struct wl_listener *listener, void *data) {
 
 	LISTEN(&client_surface(c)->events.map, &c->map, mapnotify);
 	LISTEN(&client_surface(c)->events.unmap, &c->unmap, unmapnotify);
+	LISTEN(&client_surface(c)->events.commit, &c->commit, commitx11);
+}
+
+void commitx11(struct wl_listener *listener, void *data) {
+	Client *c = wl_container_of(listener, c, commit);
+
+	client_stats_commit(c);
 }
 
 void dissociatex11(struct wl_listener *listener, void *data) {
 	Client *c = wl_container_of(listener, c, dissociate);
 	wl_list_remove(&c->map.link);
 	wl_list_remove(&c->unmap.link);
+	wl_list_remove(&c->commit.link);
 }
 
 void sethints(struct wl_listener *listener, void *data) {
@@ -7042,7 +7697,8 @@ void sethints(struct wl_listener *listener, void *data) {
 	if (c == focustop(selmon) || !c || !c->surface.xwayland->hints)
 		return;
 
-	c->isurgent = xcb_icccm_wm_hints_get_urgency(c->surface.xwayland->hints);
+	client_set_urgent(c,
+					  xcb_icccm_wm_hints_get_urgency(c->surface.xwayland->hints));
 	printstatus();
 
 	if (c->isurgent && surface && surface->mapped)
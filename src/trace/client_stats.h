@@ -0,0 +1,193 @@
+/*
+ * 每个窗口的提交频率,configure往返延迟,buffer大小和damage面积统计,
+ * 用来找出隐藏时还在高频提交的窗口,通过ipc的"get commits"查询.
+ * 窗口规则max_frame_rate可以限制发给某个窗口的帧回调频率.
+ */
+
+static struct wl_event_source *frame_throttle_timer;
+static uint64_t frame_throttle_deadline; /* 定时器下次触发的时间,0为没设置 */
+
+// 统计窗口超过这么久没更新时,提交频率按到现在为止的时间算
+#define CLIENT_STATS_WINDOW_NS 1000000000ull
+
+static uint64_t client_stats_region_area(pixman_region32_t *region) {
+	pixman_box32_t *rects;
+	uint64_t area = 0;
+	int i, n;
+
+	rects = pixman_region32_rectangles(region, &n);
+	for (i = 0; i < n; i++)
+		area += (uint64_t)(rects[i].x2 - rects[i].x1) *
+				(rects[i].y2 - rects[i].y1);
+	return area;
+}
+
+// 窗口每次提交时调用,包括隐藏和不在当前标签的时候
+void client_stats_commit(Client *c) {
+	ClientCommitStats *cs = &c->cold->commit_stats;
+	struct wlr_surface *surface = client_surface(c);
+	uint64_t now = monotonic_ns(), elapsed;
+
+	cs->commits++;
+	cs->window_commits++;
+	if (cs->commits == 1)
+		launch_stats_first_commit(c);
+	cs->buffer_width = surface->current.buffer_width;
+	cs->buffer_height = surface->current.buffer_height;
+	cs->damage_area = client_stats_region_area(&surface->buffer_damage);
+	cs->window_damage += cs->damage_area;
+
+	if (!cs->window_start_ns)
+		cs->window_start_ns = now;
+	elapsed = now - cs->window_start_ns;
+	if (elapsed >= CLIENT_STATS_WINDOW_NS) {
+		cs->commit_rate = cs->window_commits * 1e9 / elapsed;
+		cs->damage_rate = cs->window_damage * 1e9 / elapsed;
+		cs->window_start_ns = now;
+		cs->window_commits = 0;
+		cs->window_damage = 0;
+	}
+
+	// 从第一个还没确认的configure发出到确认它的提交
+	if (cs->configure_pending && !client_is_x11(c) &&
+		c->surface.xdg->current.configure_serial >= cs->configure_pending) {
+		cs->configure_latency_ns = now - cs->configure_sent_ns;
+		cs->configure_latency_avg_ns =
+			cs->configure_latency_avg_ns
+				? cs->configure_latency_avg_ns +
+					  (cs->configure_latency_ns -
+					   cs->configure_latency_avg_ns) /
+						  8
+				: cs->configure_latency_ns;
+		cs->configure_pending = 0;
+	}
+}
+
+// resize发出configure时调用
+void client_stats_configure(Client *c, uint32_t serial) {
+	if (c->cold->commit_stats.configure_pending)
+		return;
+	c->cold->commit_stats.configure_pending = serial;
+	c->cold->commit_stats.configure_sent_ns = monotonic_ns();
+}
+
+// 统计窗口过期时按到现在为止的时间计算,不再提交的窗口会降到0
+double client_stats_commit_rate(Client *c) {
+	ClientCommitStats *cs = &c->cold->commit_stats;
+	uint64_t elapsed;
+
+	if (!cs->window_start_ns)
+		return 0;
+	elapsed = monotonic_ns() - cs->window_start_ns;
+	if (elapsed < 2 * CLIENT_STATS_WINDOW_NS)
+		return cs->commit_rate;
+	return cs->window_commits * 1e9 / elapsed;
+}
+
+static void send_surface_frame_done(struct wlr_scene_buffer *buffer, int sx,
+									int sy, void *data) {
+	struct wlr_scene_surface *scene_surface =
+		wlr_scene_surface_try_from_buffer(buffer);
+
+	if (scene_surface)
+		wlr_surface_send_frame_done(scene_surface->surface, data);
+}
+
+static void frame_throttle_arm(uint64_t deadline, uint64_t now_ns) {
+	if (frame_throttle_deadline && frame_throttle_deadline <= deadline)
+		return;
+	if (!frame_throttle_timer)
+		frame_throttle_timer =
+			wl_event_loop_add_timer(event_loop, frame_throttle_timeout, NULL);
+	frame_throttle_deadline = deadline;
+	wl_event_source_timer_update(frame_throttle_timer,
+								 (deadline - now_ns) / 1000000 + 1);
+}
+
+// 给到时间的窗口补发之前扣下的帧回调
+int frame_throttle_timeout(void *data) {
+	Client *c;
+	struct timespec now;
+	uint64_t now_ns, interval, next = 0;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	now_ns = (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+	frame_throttle_deadline = 0;
+
+	wl_list_for_each(c, &clients, link) {
+		if (!c->frame_done_held)
+			continue;
+		interval = c->max_frame_rate > 0 ? 1000000000ull / c->max_frame_rate
+										 : 0;
+		if (now_ns - c->last_frame_done_ns < interval) {
+			if (!next || c->last_frame_done_ns + interval < next)
+				next = c->last_frame_done_ns + interval;
+			continue;
+		}
+		c->frame_done_held = false;
+		c->last_frame_done_ns = now_ns;
+		wlr_scene_node_for_each_buffer(&c->scene->node,
+									   send_surface_frame_done, &now);
+	}
+
+	if (next)
+		frame_throttle_arm(next, now_ns);
+	return 0;
+}
+
+struct frame_done_data {
+	Monitor *m;
+	struct timespec *now;
+};
+
+static void send_frame_done_unthrottled(struct wlr_scene_buffer *buffer,
+										int sx, int sy, void *data) {
+	struct frame_done_data *fd = data;
+	struct wlr_scene_surface *scene_surface;
+	Client *c = NULL;
+
+	if (buffer->primary_output != fd->m->scene_output)
+		return;
+	if (!(scene_surface = wlr_scene_surface_try_from_buffer(buffer)))
+		return;
+	if (toplevel_from_wlr_surface(scene_surface->surface, &c, NULL) >= 0 && c &&
+		c->frame_done_held)
+		return;
+	wlr_surface_send_frame_done(scene_surface->surface, fd->now);
+}
+
+/* 代替wlr_scene_output_send_frame_done,
+ * 被max_frame_rate限制的窗口这一帧没到时间就先不发,到时间由定时器补发 */
+void send_frame_done(Monitor *m, struct timespec *now) {
+	struct frame_done_data fd = {m, now};
+	uint64_t now_ns = (uint64_t)now->tv_sec * 1000000000ull + now->tv_nsec;
+	uint64_t interval, next = 0;
+	bool throttled = false;
+	Client *c;
+
+	wl_list_for_each(c, &clients, link) {
+		if (c->max_frame_rate <= 0 || c->iskilling || !VISIBLEON(c, m))
+			continue;
+		throttled = true;
+		interval = 1000000000ull / c->max_frame_rate;
+		if (now_ns - c->last_frame_done_ns >= interval) {
+			c->frame_done_held = false;
+			c->last_frame_done_ns = now_ns;
+		} else {
+			c->frame_done_held = true;
+			if (!next || c->last_frame_done_ns + interval < next)
+				next = c->last_frame_done_ns + interval;
+		}
+	}
+
+	if (!throttled) {
+		wlr_scene_output_send_frame_done(m->scene_output, now);
+		return;
+	}
+
+	wlr_scene_output_for_each_buffer(m->scene_output,
+									 send_frame_done_unthrottled, &fd);
+
+	if (next)
+		frame_throttle_arm(next, now_ns);
+}
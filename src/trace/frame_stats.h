@@ -0,0 +1,125 @@
+/*
+ * 每个显示器的帧耗时统计,rendermon和present事件里更新.
+ * 可以通过ipc的"get frames"查询,
+ * frame_stats_log_interval大于0时每隔这么多秒打印到日志.
+ */
+
+static struct wl_event_source *frame_stats_timer;
+
+static uint64_t monotonic_ns(void) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+static void frame_stat_add(FrameStat *s, uint64_t ns) {
+	uint64_t us = ns / 1000;
+	unsigned int bucket = 0;
+
+	// 第一个桶是[0, 64us),之后每个桶是前一个的两倍
+	while (bucket < FRAME_HIST_BUCKETS - 1 && us >= (64ull << bucket))
+		bucket++;
+	s->hist[bucket]++;
+
+	s->count++;
+	s->last_ns = ns;
+	s->min_ns = s->count == 1 ? ns : MIN(s->min_ns, ns);
+	s->max_ns = MAX(s->max_ns, ns);
+	// 指数滑动平均,大约反映最近16帧
+	s->avg_ns = s->count == 1 ? ns : s->avg_ns + ((double)ns - s->avg_ns) / 16;
+}
+
+// 以显示器刷新周期为准,没有时按60hz算
+static uint64_t frame_stats_refresh_ns(Monitor *m) {
+	if (m->frame_stats.refresh_ns)
+		return m->frame_stats.refresh_ns;
+	if (m->wlr_output->refresh > 0)
+		return 1000000000000ull / m->wlr_output->refresh;
+	return 16666667;
+}
+
+// rendermon里commit完成后调用
+void frame_stats_commit(Monitor *m, uint64_t start, uint64_t tick_done,
+						uint64_t commit_done, bool need_more_frames) {
+	FrameStats *fs = &m->frame_stats;
+
+	frame_stat_add(&fs->animate, tick_done - start);
+	frame_stat_add(&fs->commit, commit_done - tick_done);
+	// 从触发这一帧的vblank到commit完成,vblank太久以前的不算
+	if (fs->last_present_ns && commit_done > fs->last_present_ns &&
+		commit_done - fs->last_present_ns < 2 * frame_stats_refresh_ns(m))
+		frame_stat_add(&fs->frame_to_commit, commit_done - fs->last_present_ns);
+	fs->frames++;
+	fs->chained = fs->want_next;
+	fs->want_next = need_more_frames;
+}
+
+void presentmon(struct wl_listener *listener, void *data) {
+	Monitor *m = wl_container_of(listener, m, present);
+	struct wlr_output_event_present *event = data;
+	FrameStats *fs = &m->frame_stats;
+	uint64_t now, interval, refresh;
+
+	if (!event->presented)
+		return;
+
+	now = (uint64_t)event->when.tv_sec * 1000000000ull + event->when.tv_nsec;
+	if (event->refresh > 0)
+		fs->refresh_ns = event->refresh;
+
+	// 只有连续出帧的时候两次present的间隔才有意义
+	if (fs->chained && fs->last_present_ns && now > fs->last_present_ns) {
+		interval = now - fs->last_present_ns;
+		refresh = frame_stats_refresh_ns(m);
+		frame_stat_add(&fs->present_interval, interval);
+		if (interval > refresh + refresh / 2)
+			fs->missed += (interval + refresh / 2) / refresh - 1;
+	}
+	fs->last_present_ns = now;
+	launch_stats_present(m, now);
+}
+
+static void frame_stat_log(const char *output, const char *name,
+						   FrameStat *s) {
+	if (!s->count)
+		return;
+	wlr_log(WLR_INFO,
+			"frame stats %s %s: n=%llu avg=%.3fms min=%.3fms max=%.3fms", output,
+			name, (unsigned long long)s->count, s->avg_ns / 1e6,
+			s->min_ns / 1e6, s->max_ns / 1e6);
+}
+
+int frame_stats_log_all(void *data) {
+	Monitor *m;
+
+	wl_list_for_each(m, &mons, link) {
+		if (!m->wlr_output->enabled)
+			continue;
+		wlr_log(WLR_INFO, "frame stats %s: frames=%llu missed=%llu",
+				m->wlr_output->name,
+				(unsigned long long)m->frame_stats.frames,
+				(unsigned long long)m->frame_stats.missed);
+		frame_stat_log(m->wlr_output->name, "animate",
+					   &m->frame_stats.animate);
+		frame_stat_log(m->wlr_output->name, "commit", &m->frame_stats.commit);
+		frame_stat_log(m->wlr_output->name, "frame_to_commit",
+					   &m->frame_stats.frame_to_commit);
+		frame_stat_log(m->wlr_output->name, "present_interval",
+					   &m->frame_stats.present_interval);
+	}
+
+	if (frame_stats_log_interval)
+		wl_event_source_timer_update(frame_stats_timer,
+									 frame_stats_log_interval * 1000);
+	return 0;
+}
+
+// 启动和重载配置时调用
+void frame_stats_schedule_log(void) {
+	if (!frame_stats_timer)
+		frame_stats_timer =
+			wl_event_loop_add_timer(event_loop, frame_stats_log_all, NULL);
+	wl_event_source_timer_update(frame_stats_timer,
+								 frame_stats_log_interval * 1000);
+}
@@ -0,0 +1,486 @@
+/*
+ * 输入事件录制和回放,用来在同一段输入上比较不同版本的输入处理耗时.
+ * input_record_start把键盘,指针,滚轮和手势事件写成定长的二进制记录,
+ * input_replay按原来的时间间隔通过内部的虚拟键盘和指针设备重新发出,
+ * 走的是和真实设备一样的处理路径,结束后把每类事件的处理耗时和
+ * 从输入到下一次显示器commit的延迟打印到日志.
+ */
+
+#define INPUT_RECORD_MAGIC "MMIR"
+#define INPUT_RECORD_VERSION 1
+
+enum {
+	InputKey,
+	InputMotion,
+	InputMotionAbsolute,
+	InputButton,
+	InputAxis,
+	InputFrame,
+	InputSwipeBegin,
+	InputSwipeUpdate,
+	InputSwipeEnd,
+	InputPinchBegin,
+	InputPinchUpdate,
+	InputPinchEnd,
+	InputHoldBegin,
+	InputHoldEnd,
+	InputEventTypes,
+};
+
+static const char *input_event_names[] = {
+	[InputKey] = "key",
+	[InputMotion] = "motion",
+	[InputMotionAbsolute] = "motion_absolute",
+	[InputButton] = "button",
+	[InputAxis] = "axis",
+	[InputFrame] = "frame",
+	[InputSwipeBegin] = "swipe_begin",
+	[InputSwipeUpdate] = "swipe_update",
+	[InputSwipeEnd] = "swipe_end",
+	[InputPinchBegin] = "pinch_begin",
+	[InputPinchUpdate] = "pinch_update",
+	[InputPinchEnd] = "pinch_end",
+	[InputHoldBegin] = "hold_begin",
+	[InputHoldEnd] = "hold_end",
+};
+
+typedef struct {
+	char magic[4];
+	uint32_t version;
+} InputRecordHeader;
+
+/* 每个事件32字节,各字段的含义看类型:
+ * key: code键码 state按下/松开
+ * motion: v是dx,dy,unaccel_dx,unaccel_dy
+ * motion_absolute: v是0..1的x,y
+ * button: code按键 state按下/松开
+ * axis: code低8位来源,高8位relative_direction state方向 v是delta,discrete
+ * 手势: code手指数 state是否取消 v是dx,dy,scale,rotation */
+typedef struct {
+	uint64_t time_ns; /* 距离开始录制的时间 */
+	uint16_t type;
+	uint16_t state;
+	uint32_t code;
+	float v[4];
+} InputRecord;
+
+static struct {
+	FILE *file;
+	uint64_t start_ns;
+	uint64_t count;
+} input_recorder;
+
+static struct {
+	bool active;
+	bool devices_ready;
+	struct wlr_keyboard keyboard;
+	struct wlr_pointer pointer;
+	struct wl_event_source *timer;
+	InputRecord *events;
+	size_t count, next;
+	uint64_t start_ns;
+	uint64_t pending_input_ns; /* 还没等到commit的最早一个输入 */
+	FrameStat handler[InputEventTypes];
+	FrameStat latency;
+} input_replay_state;
+
+static const struct wlr_keyboard_impl input_replay_keyboard_impl = {
+	.name = "maomao-replay-keyboard",
+};
+
+static const struct wlr_pointer_impl input_replay_pointer_impl = {
+	.name = "maomao-replay-pointer",
+};
+
+// 各个输入处理函数开头调用,回放时不录制
+void input_record(uint16_t type, uint16_t state, uint32_t code, double v0,
+				  double v1, double v2, double v3) {
+	InputRecord r;
+
+	if (!input_recorder.file || input_replay_state.active)
+		return;
+
+	r.time_ns = monotonic_ns() - input_recorder.start_ns;
+	r.type = type;
+	r.state = state;
+	r.code = code;
+	r.v[0] = v0;
+	r.v[1] = v1;
+	r.v[2] = v2;
+	r.v[3] = v3;
+	if (fwrite(&r, sizeof(r), 1, input_recorder.file) != 1) {
+		wlr_log_errno(WLR_ERROR, "input record: write failed, stopping");
+		fclose(input_recorder.file);
+		input_recorder.file = NULL;
+		return;
+	}
+	input_recorder.count++;
+}
+
+void input_record_start(const Arg *arg) {
+	InputRecordHeader header = {INPUT_RECORD_MAGIC, INPUT_RECORD_VERSION};
+	char path[256];
+	const char *dir;
+
+	if (input_recorder.file) {
+		wlr_log(WLR_ERROR, "input record: already recording");
+		return;
+	}
+
+	if (arg->v && ((const char *)arg->v)[0]) {
+		snprintf(path, sizeof(path), "%s", (const char *)arg->v);
+	} else {
+		dir = getenv("XDG_RUNTIME_DIR");
+		snprintf(path, sizeof(path), "%s/maomao-input-%ld.bin",
+				 dir ? dir : "/tmp", (long)time(NULL));
+	}
+
+	if (!(input_recorder.file = fopen(path, "wb"))) {
+		wlr_log_errno(WLR_ERROR, "input record: open %s", path);
+		return;
+	}
+	if (fwrite(&header, sizeof(header), 1, input_recorder.file) != 1) {
+		wlr_log_errno(WLR_ERROR, "input record: write %s", path);
+		fclose(input_recorder.file);
+		input_recorder.file = NULL;
+		return;
+	}
+
+	input_recorder.start_ns = monotonic_ns();
+	input_recorder.count = 0;
+	wlr_log(WLR_INFO, "input record: recording to %s", path);
+}
+
+void input_record_stop(const Arg *arg) {
+	if (!input_recorder.file) {
+		wlr_log(WLR_ERROR, "input record: not recording");
+		return;
+	}
+	fclose(input_recorder.file);
+	input_recorder.file = NULL;
+	wlr_log(WLR_INFO, "input record: stopped after %llu events",
+			(unsigned long long)input_recorder.count);
+}
+
+static void input_replay_stat_log(const char *name, FrameStat *s) {
+	if (!s->count)
+		return;
+	wlr_log(WLR_INFO, "input replay %s: n=%llu avg=%.3fms min=%.3fms max=%.3fms",
+			name, (unsigned long long)s->count, s->avg_ns / 1e6,
+			s->min_ns / 1e6, s->max_ns / 1e6);
+}
+
+static void input_replay_finish(void) {
+	struct wlr_keyboard_key_event kev = {0};
+	size_t i;
+
+	// 录制结束时还按着的键在这里松开,免得卡在回放键盘上
+	kev.time_msec = monotonic_ns() / 1000000;
+	kev.update_state = true;
+	kev.state = WL_KEYBOARD_KEY_STATE_RELEASED;
+	while (input_replay_state.keyboard.num_keycodes > 0) {
+		kev.keycode = input_replay_state.keyboard
+						  .keycodes[input_replay_state.keyboard.num_keycodes -
+									1];
+		wlr_keyboard_notify_key(&input_replay_state.keyboard, &kev);
+	}
+
+	wlr_log(WLR_INFO, "input replay: %zu events in %.3fs",
+			input_replay_state.count,
+			(monotonic_ns() - input_replay_state.start_ns) / 1e9);
+	for (i = 0; i < InputEventTypes; i++)
+		input_replay_stat_log(input_event_names[i],
+							  &input_replay_state.handler[i]);
+	input_replay_stat_log("input_to_commit", &input_replay_state.latency);
+
+	free(input_replay_state.events);
+	input_replay_state.events = NULL;
+	input_replay_state.active = false;
+	input_replay_state.pending_input_ns = 0;
+}
+
+static void input_replay_emit(InputRecord *r) {
+	struct wlr_pointer *pointer = &input_replay_state.pointer;
+	uint32_t time_msec = monotonic_ns() / 1000000;
+	uint64_t start;
+
+	start = monotonic_ns();
+	switch (r->type) {
+	case InputKey: {
+		struct wlr_keyboard_key_event event = {
+			.time_msec = time_msec,
+			.keycode = r->code,
+			.update_state = true,
+			.state = r->state,
+		};
+		wlr_keyboard_notify_key(&input_replay_state.keyboard, &event);
+		break;
+	}
+	case InputMotion: {
+		struct wlr_pointer_motion_event event = {
+			.pointer = pointer,
+			.time_msec = time_msec,
+			.delta_x = r->v[0],
+			.delta_y = r->v[1],
+			.unaccel_dx = r->v[2],
+			.unaccel_dy = r->v[3],
+		};
+		wl_signal_emit_mutable(&pointer->events.motion, &event);
+		break;
+	}
+	case InputMotionAbsolute: {
+		struct wlr_pointer_motion_absolute_event event = {
+			.pointer = pointer,
+			.time_msec = time_msec,
+			.x = r->v[0],
+			.y = r->v[1],
+		};
+		wl_signal_emit_mutable(&pointer->events.motion_absolute, &event);
+		break;
+	}
+	case InputButton: {
+		struct wlr_pointer_button_event event = {
+			.pointer = pointer,
+			.time_msec = time_msec,
+			.button = r->code,
+			.state = r->state,
+		};
+		wl_signal_emit_mutable(&pointer->events.button, &event);
+		break;
+	}
+	case InputAxis: {
+		struct wlr_pointer_axis_event event = {
+			.pointer = pointer,
+			.time_msec = time_msec,
+			.source = r->code & 0xff,
+			.relative_direction = r->code >> 8,
+			.orientation = r->state,
+			.delta = r->v[0],
+			.delta_discrete = r->v[1],
+		};
+		wl_signal_emit_mutable(&pointer->events.axis, &event);
+		break;
+	}
+	case InputFrame:
+		wl_signal_emit_mutable(&pointer->events.frame, pointer);
+		break;
+	case InputSwipeBegin: {
+		struct wlr_pointer_swipe_begin_event event = {
+			.pointer = pointer,
+			.time_msec = time_msec,
+			.fingers = r->code,
+		};
+		wl_signal_emit_mutable(&pointer->events.swipe_begin, &event);
+		break;
+	}
+	case InputSwipeUpdate: {
+		struct wlr_pointer_swipe_update_event event = {
+			.pointer = pointer,
+			.time_msec = time_msec,
+			.fingers = r->code,
+			.dx = r->v[0],
+			.dy = r->v[1],
+		};
+		wl_signal_emit_mutable(&pointer->events.swipe_update, &event);
+		break;
+	}
+	case InputSwipeEnd: {
+		struct wlr_pointer_swipe_end_event event = {
+			.pointer = pointer,
+			.time_msec = time_msec,
+			.cancelled = r->state,
+		};
+		wl_signal_emit_mutable(&pointer->events.swipe_end, &event);
+		break;
+	}
+	case InputPinchBegin: {
+		struct wlr_pointer_pinch_begin_event event = {
+			.pointer = pointer,
+			.time_msec = time_msec,
+			.fingers = r->code,
+		};
+		wl_signal_emit_mutable(&pointer->events.pinch_begin, &event);
+		break;
+	}
+	case InputPinchUpdate: {
+		struct wlr_pointer_pinch_update_event event = {
+			.pointer = pointer,
+			.time_msec = time_msec,
+			.fingers = r->code,
+			.dx = r->v[0],
+			.dy = r->v[1],
+			.scale = r->v[2],
+			.rotation = r->v[3],
+		};
+		wl_signal_emit_mutable(&pointer->events.pinch_update, &event);
+		break;
+	}
+	case InputPinchEnd: {
+		struct wlr_pointer_pinch_end_event event = {
+			.pointer = pointer,
+			.time_msec = time_msec,
+			.cancelled = r->state,
+		};
+		wl_signal_emit_mutable(&pointer->events.pinch_end, &event);
+		break;
+	}
+	case InputHoldBegin: {
+		struct wlr_pointer_hold_begin_event event = {
+			.pointer = pointer,
+			.time_msec = time_msec,
+			.fingers = r->code,
+		};
+		wl_signal_emit_mutable(&pointer->events.hold_begin, &event);
+		break;
+	}
+	case InputHoldEnd: {
+		struct wlr_pointer_hold_end_event event = {
+			.pointer = pointer,
+			.time_msec = time_msec,
+			.cancelled = r->state,
+		};
+		wl_signal_emit_mutable(&pointer->events.hold_end, &event);
+		break;
+	}
+	default:
+		return;
+	}
+
+	frame_stat_add(&input_replay_state.handler[r->type],
+				   monotonic_ns() - start);
+	if (!input_replay_state.pending_input_ns)
+		input_replay_state.pending_input_ns = start;
+}
+
+// 把到时间的事件都发出去,再按下一个事件的时间重新设定时器
+int input_replay_timeout(void *data) {
+	uint64_t elapsed;
+	InputRecord *r;
+
+	if (!input_replay_state.active)
+		return 0;
+
+	if (input_replay_state.next == input_replay_state.count) {
+		input_replay_finish();
+		return 0;
+	}
+
+	elapsed = monotonic_ns() - input_replay_state.start_ns;
+	while (input_replay_state.next < input_replay_state.count) {
+		r = &input_replay_state.events[input_replay_state.next];
+		if (r->time_ns > elapsed)
+			break;
+		input_replay_emit(r);
+		input_replay_state.next++;
+	}
+
+	// 最后一个事件发完后再等一会,让它对应的commit也能统计到
+	if (input_replay_state.next == input_replay_state.count)
+		wl_event_source_timer_update(input_replay_state.timer, 500);
+	else
+		wl_event_source_timer_update(
+			input_replay_state.timer,
+			(input_replay_state.events[input_replay_state.next].time_ns -
+			 elapsed) / 1000000 +
+				1);
+	return 0;
+}
+
+// rendermon里commit完成后调用
+void input_replay_commit(uint64_t commit_ns) {
+	if (!input_replay_state.pending_input_ns)
+		return;
+	frame_stat_add(&input_replay_state.latency,
+				   commit_ns - input_replay_state.pending_input_ns);
+	input_replay_state.pending_input_ns = 0;
+}
+
+void input_replay(const Arg *arg) {
+	InputRecordHeader header;
+	long size;
+	FILE *f;
+
+	if (input_replay_state.active) {
+		wlr_log(WLR_ERROR, "input replay: already replaying");
+		return;
+	}
+	if (!arg->v || !((const char *)arg->v)[0]) {
+		wlr_log(WLR_ERROR, "input replay: no file given");
+		return;
+	}
+
+	if (!(f = fopen(arg->v, "rb"))) {
+		wlr_log_errno(WLR_ERROR, "input replay: open %s",
+					  (const char *)arg->v);
+		return;
+	}
+	if (fread(&header, sizeof(header), 1, f) != 1 ||
+		memcmp(header.magic, INPUT_RECORD_MAGIC, 4) != 0 ||
+		header.version != INPUT_RECORD_VERSION) {
+		wlr_log(WLR_ERROR, "input replay: %s is not an input recording",
+				(const char *)arg->v);
+		fclose(f);
+		return;
+	}
+
+	fseek(f, 0, SEEK_END);
+	size = ftell(f) - (long)sizeof(header);
+	fseek(f, sizeof(header), SEEK_SET);
+	input_replay_state.count = size > 0 ? size / sizeof(InputRecord) : 0;
+	if (!input_replay_state.count) {
+		wlr_log(WLR_ERROR, "input replay: %s has no events",
+				(const char *)arg->v);
+		fclose(f);
+		return;
+	}
+	input_replay_state.events =
+		ecalloc(input_replay_state.count, sizeof(InputRecord));
+	input_replay_state.count =
+		fread(input_replay_state.events, sizeof(InputRecord),
+			  input_replay_state.count, f);
+	fclose(f);
+
+	// 回放设备第一次用时创建,和真实设备一样加进键盘组和光标
+	if (!input_replay_state.devices_ready) {
+		wlr_keyboard_init(&input_replay_state.keyboard,
+						  &input_replay_keyboard_impl,
+						  input_replay_keyboard_impl.name);
+		wlr_pointer_init(&input_replay_state.pointer,
+						 &input_replay_pointer_impl,
+						 input_replay_pointer_impl.name);
+		inputdevice(NULL, &input_replay_state.keyboard.base);
+		inputdevice(NULL, &input_replay_state.pointer.base);
+		input_replay_state.devices_ready = true;
+	}
+	if (!input_replay_state.timer)
+		input_replay_state.timer =
+			wl_event_loop_add_timer(event_loop, input_replay_timeout, NULL);
+
+	memset(input_replay_state.handler, 0, sizeof(input_replay_state.handler));
+	memset(&input_replay_state.latency, 0, sizeof(input_replay_state.latency));
+	input_replay_state.next = 0;
+	input_replay_state.pending_input_ns = 0;
+	input_replay_state.start_ns = monotonic_ns();
+	input_replay_state.active = true;
+	wlr_log(WLR_INFO, "input replay: replaying %zu events from %s",
+			input_replay_state.count, (const char *)arg->v);
+	input_replay_timeout(NULL);
+}
+
+// cleanup里在销毁键盘组之前调用
+void input_record_finish(void) {
+	if (input_recorder.file) {
+		fclose(input_recorder.file);
+		input_recorder.file = NULL;
+	}
+	free(input_replay_state.events);
+	input_replay_state.events = NULL;
+	input_replay_state.active = false;
+	if (input_replay_state.timer)
+		wl_event_source_remove(input_replay_state.timer);
+	if (input_replay_state.devices_ready) {
+		wlr_keyboard_finish(&input_replay_state.keyboard);
+		wlr_pointer_finish(&input_replay_state.pointer);
+		input_replay_state.devices_ready = false;
+	}
+}
@@ -0,0 +1,152 @@
+/*
+ * 程序启动耗时:spawn时记下命令和时间,拿到子进程pid后,
+ * 新窗口第一次提交时用client_get_pid()和进程祖先链去匹配,
+ * 之后依次记录第一次提交,map开始和结束(包括applyrules),
+ * 第一次显示出来(present)和打开动画结束的时间.
+ * 通过ipc的"get launches"查询,用-Dtrace=true编译时也会写进trace.
+ */
+
+#define LAUNCH_RECORDS 32 /* 只保留最近这么多次启动 */
+#define LAUNCH_MATCH_NS (60 * 1000000000ull) /* 超过这么久才出窗口的不算 */
+
+typedef struct {
+	char cmd[64];
+	char appid[64];
+	pid_t pid;		   /* 0为还不知道 */
+	bool awaiting_pid; /* 等启动器回复pid */
+	Client *c;		   /* 匹配到的窗口,窗口销毁后为NULL */
+	uint64_t spawn_ns, commit_ns, map_start_ns, map_done_ns, present_ns,
+		animation_done_ns;
+} LaunchRecord;
+
+static struct {
+	LaunchRecord records[LAUNCH_RECORDS];
+	unsigned int count; /* 总共记录过的启动次数 */
+} launch_stats;
+
+LaunchRecord *launch_stats_spawn(const char *cmd) {
+	LaunchRecord *r = &launch_stats.records[launch_stats.count++ %
+											LAUNCH_RECORDS];
+
+	memset(r, 0, sizeof(*r));
+	snprintf(r->cmd, sizeof(r->cmd), "%s", cmd);
+	r->spawn_ns = monotonic_ns();
+	return r;
+}
+
+// 启动器按spawn的顺序回复pid,交给最早一个还在等的记录
+void launch_stats_pid(pid_t pid) {
+	unsigned int i, start;
+	LaunchRecord *r;
+
+	start = launch_stats.count > LAUNCH_RECORDS
+				? launch_stats.count - LAUNCH_RECORDS
+				: 0;
+	for (i = start; i < launch_stats.count; i++) {
+		r = &launch_stats.records[i % LAUNCH_RECORDS];
+		if (!r->awaiting_pid)
+			continue;
+		r->awaiting_pid = false;
+		r->pid = pid > 0 ? pid : 0;
+		return;
+	}
+}
+
+// 启动器退出时,还在等的pid不会再来了
+void launch_stats_pid_lost(void) {
+	unsigned int i;
+
+	for (i = 0; i < LAUNCH_RECORDS; i++)
+		launch_stats.records[i].awaiting_pid = false;
+}
+
+static LaunchRecord *launch_stats_find(Client *c) {
+	unsigned int i;
+
+	for (i = 0; i < LAUNCH_RECORDS; i++) {
+		if (launch_stats.records[i].c == c)
+			return &launch_stats.records[i];
+	}
+	return NULL;
+}
+
+// 窗口第一次提交时调用,从最近一次启动往前找
+void launch_stats_first_commit(Client *c) {
+	uint64_t now = monotonic_ns();
+	pid_t pid = client_get_pid(c);
+	LaunchRecord *r;
+	unsigned int i;
+
+	if (pid <= 0)
+		return;
+
+	for (i = launch_stats.count; i-- > 0 && launch_stats.count - i <=
+										   LAUNCH_RECORDS;) {
+		r = &launch_stats.records[i % LAUNCH_RECORDS];
+		if (now - r->spawn_ns > LAUNCH_MATCH_NS)
+			break;
+		if (r->c || r->commit_ns || !r->pid || !isdescprocess(r->pid, pid))
+			continue;
+		r->c = c;
+		r->commit_ns = now;
+		TRACE_SPAN("launch: spawn to first commit", r->spawn_ns, now, r->pid);
+		return;
+	}
+}
+
+void launch_stats_map_start(Client *c) {
+	LaunchRecord *r = launch_stats_find(c);
+
+	if (r && !r->map_start_ns)
+		r->map_start_ns = monotonic_ns();
+}
+
+void launch_stats_map_done(Client *c) {
+	LaunchRecord *r = launch_stats_find(c);
+
+	if (!r || r->map_done_ns)
+		return;
+	r->map_done_ns = monotonic_ns();
+	snprintf(r->appid, sizeof(r->appid), "%s", client_get_appid(c));
+	TRACE_SPAN("launch: map", r->map_start_ns, r->map_done_ns, r->pid);
+}
+
+// presentmon里调用,窗口map之后这个显示器第一次显示出来的时间
+void launch_stats_present(Monitor *m, uint64_t when) {
+	LaunchRecord *r;
+	unsigned int i;
+
+	for (i = 0; i < LAUNCH_RECORDS; i++) {
+		r = &launch_stats.records[i];
+		if (!r->c || !r->map_done_ns || r->present_ns ||
+			when < r->map_done_ns || !VISIBLEON(r->c, m))
+			continue;
+		r->present_ns = when;
+		TRACE_SPAN("launch: map to first frame", r->map_done_ns, when,
+				   r->pid);
+		TRACE_SPAN("launch", r->spawn_ns, when, r->pid);
+		wlr_log(WLR_DEBUG,
+				"launch %s (%s): commit %.1fms map %.1fms present %.1fms", r->cmd,
+				r->appid, (r->commit_ns - r->spawn_ns) / 1e6,
+				(r->map_done_ns - r->map_start_ns) / 1e6,
+				(when - r->spawn_ns) / 1e6);
+	}
+}
+
+// 打开动画结束时调用
+void launch_stats_animation_done(Client *c) {
+	LaunchRecord *r = launch_stats_find(c);
+
+	if (!r || !r->present_ns || r->animation_done_ns)
+		return;
+	r->animation_done_ns = monotonic_ns();
+	TRACE_SPAN("launch: open animation", r->map_done_ns, r->animation_done_ns,
+			   r->pid);
+}
+
+void launch_stats_client_gone(Client *c) {
+	LaunchRecord *r = launch_stats_find(c);
+
+	if (r)
+		r->c = NULL;
+}
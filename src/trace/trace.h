@@ -0,0 +1,145 @@
+/*
+ * 事件循环耗时追踪,只有用meson -Dtrace=true编译时才会记录.
+ * trace_start开始往固定大小的环形缓冲区里记录begin/end事件,
+ * trace_dump把缓冲区写成chrome trace event格式的json并停止记录,
+ * 可以用chrome://tracing或者ui.perfetto.dev打开.
+ */
+
+#ifdef TRACE
+
+#define TRACE_EVENTS 65536 /* 缓冲区满了之后覆盖最旧的事件 */
+
+typedef struct {
+	const char *name; /* 必须是静态字符串 */
+	uint64_t ts;	  /* CLOCK_MONOTONIC,纳秒 */
+	char phase;		  /* 'B'或者'E' */
+	int tid;		  /* 0是事件循环,其他值是单独的一行,比如启动的进程pid */
+} TraceEvent;
+
+static struct {
+	bool enabled;
+	TraceEvent *events;
+	uint64_t count; /* 开始记录后总共记录过的事件数 */
+} tracer;
+
+static inline void trace_event(const char *name, char phase) {
+	struct timespec now;
+	TraceEvent *e;
+
+	if (!tracer.enabled)
+		return;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	e = &tracer.events[tracer.count++ % TRACE_EVENTS];
+	e->name = name;
+	e->phase = phase;
+	e->ts = (uint64_t)now.tv_sec * 1000000000ull + now.tv_nsec;
+	e->tid = 0;
+}
+
+// 补记一段已经结束的区间,放在单独的tid里,不和事件循环的嵌套混在一起
+static inline void trace_span(const char *name, uint64_t start, uint64_t end,
+							  int tid) {
+	TraceEvent *e;
+
+	if (!tracer.enabled || !start || end < start)
+		return;
+
+	e = &tracer.events[tracer.count++ % TRACE_EVENTS];
+	*e = (TraceEvent){.name = name, .ts = start, .phase = 'B', .tid = tid};
+	e = &tracer.events[tracer.count++ % TRACE_EVENTS];
+	*e = (TraceEvent){.name = name, .ts = end, .phase = 'E', .tid = tid};
+}
+
+static inline void trace_scope_end(const char **name) {
+	trace_event(*name, 'E');
+}
+
+#define TRACE_BEGIN(name) trace_event(name, 'B')
+#define TRACE_END(name) trace_event(name, 'E')
+#define TRACE_SPAN(name, start, end, tid) trace_span(name, start, end, tid)
+// 函数开头用,离开作用域时自动记录end,一个作用域里只能用一次
+#define TRACE_SCOPE(name)                                                      \
+	const char *trace_scope_name                                               \
+		__attribute__((cleanup(trace_scope_end))) = (name);                    \
+	trace_event(trace_scope_name, 'B')
+
+#else
+
+#define TRACE_BEGIN(name) ((void)0)
+#define TRACE_END(name) ((void)0)
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_SPAN(name, start, end, tid) ((void)0)
+
+#endif
+
+void trace_start(const Arg *arg) {
+#ifdef TRACE
+	if (!tracer.events)
+		tracer.events = ecalloc(TRACE_EVENTS, sizeof(TraceEvent));
+	tracer.count = 0;
+	tracer.enabled = true;
+	wlr_log(WLR_INFO, "trace: recording started");
+#else
+	wlr_log(WLR_ERROR, "trace: not available, rebuild with -Dtrace=true");
+#endif
+}
+
+void trace_dump(const Arg *arg) {
+#ifdef TRACE
+	char path[256];
+	const char *dir;
+	uint64_t i, start;
+	unsigned int depth = 0;
+	TraceEvent *e;
+	bool first = true;
+	FILE *f;
+
+	if (!tracer.events) {
+		wlr_log(WLR_ERROR, "trace: nothing recorded, run trace_start first");
+		return;
+	}
+
+	tracer.enabled = false;
+
+	if (arg->v && ((const char *)arg->v)[0]) {
+		snprintf(path, sizeof(path), "%s", (const char *)arg->v);
+	} else {
+		dir = getenv("XDG_RUNTIME_DIR");
+		snprintf(path, sizeof(path), "%s/maomao-trace-%ld.json",
+				 dir ? dir : "/tmp", (long)time(NULL));
+	}
+
+	if (!(f = fopen(path, "w"))) {
+		wlr_log_errno(WLR_ERROR, "trace: open %s", path);
+		return;
+	}
+
+	fprintf(f, "{\"traceEvents\":[\n");
+	start = tracer.count > TRACE_EVENTS ? tracer.count - TRACE_EVENTS : 0;
+	for (i = start; i < tracer.count; i++) {
+		e = &tracer.events[i % TRACE_EVENTS];
+		// 开头被覆盖掉的begin对应的end没法配对,跳过
+		if (e->phase == 'E') {
+			if (!depth)
+				continue;
+			depth--;
+		} else {
+			depth++;
+		}
+		fprintf(f,
+				"%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,"
+				"\"tid\":%d}",
+				first ? "" : ",\n", e->name, e->phase, e->ts / 1000.0,
+				(int)getpid(), e->tid);
+		first = false;
+	}
+	fprintf(f, "\n],\"displayTimeUnit\":\"ms\"}\n");
+	fclose(f);
+
+	wlr_log(WLR_INFO, "trace: wrote %llu events to %s",
+			(unsigned long long)(tracer.count - start), path);
+#else
+	wlr_log(WLR_ERROR, "trace: not available, rebuild with -Dtrace=true");
+#endif
+}